@@ -6,6 +6,44 @@
 #include <optional>
 #include <string>
 #include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <list>
+#include <condition_variable>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <iterator>
+#include <bitset>
+#include <ctime>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SH3_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SH3_HAVE_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#if defined(__GNUC__)
+#define SH3_ALWAYS_INLINE inline __attribute__((always_inline))
+#define SH3_RESTRICT __restrict__
+#else
+#define SH3_ALWAYS_INLINE inline
+#define SH3_RESTRICT
+#endif
 
 enum class RngBackend {
     PS2,
@@ -38,447 +76,4020 @@ static inline uint32_t rng_next31(uint32_t &state, RngBackend backend) {
     return pc_rand31_from_three(state);
 }
 
-static inline void rng_advance(uint32_t &state, RngBackend backend, int n) {
-    for (int i = 0; i < n; ++i) rng_next31(state, backend);
+// Backend policies fix the generator at compile time. Hot loops take one as
+// a template parameter, so each backend gets its own inlined loop with no
+// per-draw branch. with_backend(backend, fn) turns the runtime choice into
+// a policy once, where a scan starts; a new backend is one more policy.
+struct Ps2Backend {
+    static constexpr RngBackend id = RngBackend::PS2;
+    static constexpr uint32_t stateMask = 0x7FFFFFFFu;
+    static SH3_ALWAYS_INLINE uint32_t next31(uint32_t &state) { return ps2_rand32_step(state); }
+};
+
+struct PcBackend {
+    static constexpr RngBackend id = RngBackend::PC;
+    static constexpr uint32_t stateMask = 0xFFFFFFFFu;
+    static SH3_ALWAYS_INLINE uint32_t next31(uint32_t &state) { return pc_rand31_from_three(state); }
+};
+
+template <typename Fn>
+static SH3_ALWAYS_INLINE decltype(auto) with_backend(RngBackend backend, Fn &&fn) {
+    if (backend == RngBackend::PS2) return fn(Ps2Backend{});
+    return fn(PcBackend{});
 }
 
-static constexpr uint64_t PS2_MOD = 0x80000000ull;
-static constexpr uint64_t PS2_A   = 0x41C64E6Dull;
-static constexpr uint64_t PS2_C   = 0x3039ull;
+// Affine map x -> mul * x + add (mod 2^32). Both generators are power-of-two
+// modulus LCGs, so any number of steps collapses into one such map; the PS2
+// 2^31 modulus is applied by masking when the map is evaluated.
+struct LcgAffine {
+    uint32_t mul;
+    uint32_t add;
+};
+
+// Map that applies `first`, then `second`.
+static constexpr LcgAffine lcg_compose(LcgAffine first, LcgAffine second) {
+    return {second.mul * first.mul, second.mul * first.add + second.add};
+}
 
-static uint64_t modinv(uint64_t a, uint64_t m) {
-    int64_t t = 0, newt = 1;
-    int64_t r = (int64_t)m, newr = (int64_t)a;
-    while (newr != 0) {
-        int64_t q = r / newr;
-        int64_t tmp = t - q * newt; t = newt; newt = tmp;
-        tmp = r - q * newr; r = newr; newr = tmp;
+static constexpr LcgAffine PS2_ADVANCE = {0x41C64E6Du, 0x3039u};
+static constexpr LcgAffine PC_STEP     = {0x000343FDu, 0x00269EC3u};
+// One PC advance is one rand31, i.e. three rand15 steps.
+static constexpr LcgAffine PC_ADVANCE  = lcg_compose(lcg_compose(PC_STEP, PC_STEP), PC_STEP);
+
+using LcgJumpTable = std::array<LcgAffine, 64>;
+
+// table[k] = advance map raised to 2^k, so a jump of n advances needs one
+// composition per set bit of n.
+static constexpr LcgJumpTable make_jump_table(LcgAffine advance) {
+    LcgJumpTable table{};
+    table[0] = advance;
+    for (size_t k = 1; k < table.size(); ++k) table[k] = lcg_compose(table[k - 1], table[k - 1]);
+    return table;
+}
+
+// Map that undoes `map`: x -> mul^-1 * (x - add). mul is odd, so mul * mul
+// = 1 (mod 8) and each Newton step doubles the bits of the inverse that are
+// right; five steps cover all 32.
+static constexpr LcgAffine lcg_inverse(LcgAffine map) {
+    uint32_t inv = map.mul;
+    for (int i = 0; i < 5; ++i) inv *= 2u - map.mul * inv;
+    return {inv, 0u - inv * map.add};
+}
+
+static constexpr LcgAffine PS2_RETREAT = lcg_inverse(PS2_ADVANCE);
+static constexpr LcgAffine PC_RETREAT  = lcg_inverse(PC_ADVANCE);
+static_assert(lcg_compose(PS2_ADVANCE, PS2_RETREAT).mul == 1u && lcg_compose(PS2_ADVANCE, PS2_RETREAT).add == 0u,
+              "PS2 retreat map must undo one advance");
+static_assert(lcg_compose(PC_ADVANCE, PC_RETREAT).mul == 1u && lcg_compose(PC_ADVANCE, PC_RETREAT).add == 0u,
+              "PC retreat map must undo one advance");
+
+static constexpr LcgJumpTable PS2_JUMP_TABLE   = make_jump_table(PS2_ADVANCE);
+static constexpr LcgJumpTable PC_JUMP_TABLE    = make_jump_table(PC_ADVANCE);
+static constexpr LcgJumpTable PS2_REWIND_TABLE = make_jump_table(PS2_RETREAT);
+static constexpr LcgJumpTable PC_REWIND_TABLE  = make_jump_table(PC_RETREAT);
+
+static inline LcgAffine lcg_jump(const LcgJumpTable &table, uint64_t n) {
+    LcgAffine acc = {1u, 0u};
+    for (size_t k = 0; n != 0; ++k, n >>= 1) {
+        if (n & 1u) acc = lcg_compose(acc, table[k]);
     }
-    if (r > 1) return 0;
-    if (t < 0) t += (int64_t)m;
-    return (uint64_t)t;
+    return acc;
 }
 
-static inline uint32_t ps2_prev_seed(uint32_t cur, uint64_t invA) {
-    uint64_t x = (cur + PS2_MOD - (PS2_C % PS2_MOD)) % PS2_MOD;
-    uint64_t prev = (invA * x) % PS2_MOD;
-    return (uint32_t)prev;
+static inline LcgAffine rng_jump(RngBackend backend, uint64_t n) {
+    return lcg_jump((backend == RngBackend::PS2) ? PS2_JUMP_TABLE : PC_JUMP_TABLE, n);
 }
 
-static inline uint32_t ps2_rewind_n(uint32_t seed, int n, uint64_t invA) {
-    for (int i = 0; i < n; ++i) seed = ps2_prev_seed(seed, invA);
-    return seed;
+// Map that moves a state back n advances. Built once per distance, it
+// rewinds any number of states with one multiply-add each.
+static inline LcgAffine rng_rewind_jump(RngBackend backend, uint64_t n) {
+    return lcg_jump((backend == RngBackend::PS2) ? PS2_REWIND_TABLE : PC_REWIND_TABLE, n);
 }
 
-std::vector<uint32_t> find_clock_base_seeds(int targetHour, int targetMinute, uint8_t modeByte,
-                                           int warmupAfterReset, int maxResults = 200) {
-    std::vector<uint32_t> out;
-    uint64_t invA = modinv(PS2_A % PS2_MOD, PS2_MOD);
-    if (!invA) return out;
+static inline uint32_t rng_apply(LcgAffine map, uint32_t state, RngBackend backend) {
+    uint32_t next = map.mul * state + map.add;
+    return (backend == RngBackend::PS2) ? (next & 0x7FFFFFFFu) : next;
+}
 
-    int rem;
-    if (modeByte == 2) {
-        rem = targetHour - 12;
-        if (rem < 0 || rem > 11) return out;
-    } else {
-        rem = targetHour - 1;
-        if (rem < 0 || rem > 11) return out;
+// Moves `state` forward n advances in at most 64 compositions. Seeking costs
+// the same from any base seed, so a query on the new-game stream (seed 0)
+// with a large minAdvances starts as quickly as one with minAdvances = 0,
+// and no table of precomputed stream checkpoints is kept.
+static inline void rng_advance(uint32_t &state, RngBackend backend, uint64_t n) {
+    state = rng_apply(rng_jump(backend, n), state, backend);
+}
+
+static inline void rng_rewind(uint32_t &state, RngBackend backend, uint64_t n) {
+    state = rng_apply(rng_rewind_jump(backend, n), state, backend);
+}
+
+static inline uint32_t rng_state_mask(RngBackend backend) {
+    return (backend == RngBackend::PS2) ? 0x7FFFFFFFu : 0xFFFFFFFFu;
+}
+
+static inline uint64_t rng_period(RngBackend backend) {
+    return (uint64_t)rng_state_mask(backend) + 1u;
+}
+
+// Advances from baseSeed to targetSeed, solved exactly over the full period.
+// Both advance maps have mul = 1 (mod 4) and an odd add, so jumping by 2^k
+// flips bit k of the state and leaves the lower bits alone: the distance can
+// be read off one bit at a time, lowest first.
+std::optional<uint64_t> find_seed_distance(uint32_t baseSeed, uint32_t targetSeed, RngBackend backend) {
+    if (baseSeed == targetSeed) return 0;
+
+    const uint32_t mask = rng_state_mask(backend);
+    if (targetSeed & ~mask) return std::nullopt;
+
+    const LcgJumpTable &table = (backend == RngBackend::PS2) ? PS2_JUMP_TABLE : PC_JUMP_TABLE;
+    uint32_t cur = baseSeed & mask;
+    // A PS2 base with bit 31 set only rejoins the cycle after its first step.
+    if (cur == targetSeed) return rng_period(backend);
+
+    uint64_t dist = 0;
+    for (size_t k = 0; cur != targetSeed; ++k) {
+        uint32_t bit = 1u << k;
+        if ((cur ^ targetSeed) & bit) {
+            cur = rng_apply(table[k], cur, backend);
+            dist |= (uint64_t)bit;
+        }
     }
+    return dist;
+}
 
-    uint64_t start = (uint64_t)((targetMinute % 60) + 60) % 60;
-    for (uint64_t s2 = start; s2 < PS2_MOD; s2 += 60) {
-        uint32_t seed2 = (uint32_t)s2;
-        uint32_t seed1 = ps2_prev_seed(seed2, invA);
+// Lets a caller abandon a scan from outside: the scan is aborted once
+// `latest` has moved past `ticket` (the server bumps it when a newer
+// request supersedes this one).
+struct ScanAbort {
+    const std::atomic<uint64_t> *latest;
+    uint64_t ticket;
 
-        if ((int)(seed1 % 12) != rem) continue;
+    bool aborted() const { return latest->load(std::memory_order_relaxed) != ticket; }
+};
 
-        uint32_t seed_w = ps2_prev_seed(seed1, invA);
-        uint32_t base   = ps2_rewind_n(seed_w, warmupAfterReset, invA);
+// Abort for scans started on this thread; scan_sharded hands it to its shards.
+static thread_local const ScanAbort *scan_abort = nullptr;
+
+// Per-query instrumentation, on when SH3_STATS is set. Every shard counts
+// into its own ScanTally (a null pointer when stats are off, so the
+// kernels pay one predictable branch per block), and scan_sharded folds
+// the tallies and its phase timings into the thread's QueryStats.
+static constexpr int STATS_STAGES = 5;   // four draws, then the forced-7 draw
+
+struct ScanTally {
+    uint64_t draws = 0;       // rand31 values generated
+    uint64_t jumps = 0;       // O(log n) seeks
+    uint64_t windows = 0;     // candidate advances evaluated
+    uint64_t sieved = 0;      // advances the PS2 sieve skipped without drawing
+    uint64_t rejected[STATS_STAGES] = {};
+    uint64_t matches = 0;     // matches the shards recorded
+
+    void add(const ScanTally &o) {
+        draws += o.draws;
+        jumps += o.jumps;
+        windows += o.windows;
+        sieved += o.sieved;
+        for (int k = 0; k < STATS_STAGES; ++k) rejected[k] += o.rejected[k];
+        matches += o.matches;
+    }
+};
 
-        out.push_back(base);
-        if ((int)out.size() >= maxResults) break;
+struct QueryStats {
+    std::mutex mutex;
+    ScanTally tally;
+    uint64_t scans = 0;             // scan_sharded calls
+    uint64_t advances = 0;          // advances in the shards they started
+    double seekSeconds = 0.0;       // skipping to shard starts, summed over threads
+    double scanSeconds = 0.0;       // scanning shards, summed over threads
+    double scanWallSeconds = 0.0;
+    std::chrono::steady_clock::time_point firstScan, lastScanEnd;
+    std::clock_t firstScanCpu = 0;
+
+    // JSON object for the query so far. Output is the time since the last
+    // scan ended: merging, decoding and printing the results.
+    std::string json() {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto now = std::chrono::steady_clock::now();
+        const double wall = scans ? std::chrono::duration<double>(now - firstScan).count() : 0.0;
+        const double output = scans ? std::chrono::duration<double>(now - lastScanEnd).count() : 0.0;
+        const double cpu = scans ? (double)(std::clock() - firstScanCpu) / CLOCKS_PER_SEC : 0.0;
+        uint64_t rejected = 0;
+        for (uint64_t r : tally.rejected) rejected += r;
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(6)
+            << "{\"wallSeconds\":" << wall << ",\"cpuSeconds\":" << cpu
+            << ",\"phases\":{\"seek\":" << seekSeconds << ",\"scan\":" << scanSeconds
+            << ",\"scanWall\":" << scanWallSeconds << ",\"output\":" << output << "}"
+            << std::setprecision(0)
+            << ",\"scans\":" << scans << ",\"advances\":" << advances
+            << ",\"advancesPerSecond\":" << (scanWallSeconds > 0.0 ? (double)advances / scanWallSeconds : 0.0)
+            << ",\"rngDraws\":" << tally.draws << ",\"jumps\":" << tally.jumps
+            << ",\"candidates\":" << tally.windows << ",\"sieved\":" << tally.sieved
+            << ",\"rejectedByStage\":[";
+        for (int k = 0; k < STATS_STAGES; ++k) out << (k ? "," : "") << tally.rejected[k];
+        out << "],\"accepted\":" << (tally.windows - std::min(rejected, tally.windows))
+            << ",\"matches\":" << tally.matches << "}";
+        return out.str();
     }
+};
 
-    return out;
+// Stats for queries run on this thread; null when stats are off.
+static thread_local QueryStats *scan_stats = nullptr;
+
+static bool stats_enabled() {
+    const char *env = std::getenv("SH3_STATS");
+    return env && *env && std::string(env) != "0";
 }
 
-std::optional<int> find_warmup_for_first(uint32_t baseSeed, uint32_t R_first, RngBackend backend, int maxSearch = 2000000) {
-    uint32_t seed = baseSeed;
-    for (int warmup = 0; warmup <= maxSearch; ++warmup) {
-        uint32_t tmp = seed;
-        uint32_t r = rng_next31(tmp, backend);
-        if (r == R_first) return warmup;
-        rng_next31(seed, backend);
+// Collects stats for the queries this thread runs until it goes out of
+// scope, then prints them to `report` if given; null `stats` when they
+// are off.
+struct QueryStatsScope {
+    std::unique_ptr<QueryStats> stats;
+    std::ostream *report;
+
+    explicit QueryStatsScope(std::ostream *report = nullptr) : report(report) {
+        if (!stats_enabled()) return;
+        stats = std::make_unique<QueryStats>();
+        scan_stats = stats.get();
     }
-    return std::nullopt;
-}
+    ~QueryStatsScope() {
+        if (!stats) return;
+        scan_stats = nullptr;
+        if (report) *report << "\nStats: " << stats->json() << "\n";
+    }
+};
 
-uint32_t gen_shakespeare_code(uint32_t seed, int warmupAfterReset, RngBackend backend, bool verbose=false) {
-    rng_advance(seed, backend, warmupAfterReset);
+// One contiguous slice of a scan. `seed` is the state after `first` advances,
+// so each shard starts independently via jump-ahead.
+struct ScanShard {
+    size_t index;
+    int64_t first;
+    int64_t last;
+    uint32_t seed;
+    const std::atomic<size_t> *cancelAbove;
+    const ScanAbort *abort = nullptr;
+    ScanTally *tally = nullptr;
+
+    // True once lower shards already hold the earliest maxResults matches,
+    // or the whole scan was aborted.
+    bool cancelled() const {
+        return cancelAbove->load(std::memory_order_relaxed) < index || (abort && abort->aborted());
+    }
+};
 
-    std::vector<int> pool{0,1,2,3,4,5,6,7,8,9};
-    uint32_t code4 = 0;
+static constexpr int64_t SCAN_CANCEL_CHECK_MASK = 0xFFFF;
 
-    for (int i = 0; i < 4; ++i) {
-        int32_t r = static_cast<int32_t>(rng_next31(seed, backend));
-        int size = 10 - i;
+// Interactive runs report progress on stderr for scans of at least
+// SCAN_PROGRESS_MIN advances (a full period takes a while); batch, server
+// and bench output stays clean.
+static bool scan_progress = false;
+static constexpr uint64_t SCAN_PROGRESS_MIN = uint64_t(1) << 28;
 
-        int idx = r % size;
-        if (idx < 0) idx += size;
+// SH3_THREADS overrides the worker count (e.g. SH3_THREADS=1 for a serial run).
+static unsigned scan_thread_count() {
+    if (const char *env = std::getenv("SH3_THREADS")) {
+        int n = std::atoi(env);
+        if (n > 0) return (unsigned)n;
+    }
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1u;
+}
 
-        int digit = pool[idx];
-        code4 = (code4 << 4) + static_cast<uint32_t>(digit);
+// Scans advances [minAdvances, maxAdvances] from startSeed in shards on a
+// thread pool; each shard jumps straight to its first advance.
+// scanShard(shard, out) appends the shard's matches to `out` in advance
+// order and may stop after maxResults of them. Shards are merged in
+// order, so the result is the same earliest maxResults the serial loop gives.
+// prefixDone(matches) sees each shard's matches in order as the finished
+// prefix grows; once it returns true, shards above that one are cancelled,
+// for callers whose quota is not a plain match count.
+template <typename Match, typename ShardFn, typename PrefixFn>
+static std::vector<Match> scan_sharded(uint32_t startSeed, RngBackend backend,
+                                       int64_t minAdvances, int64_t maxAdvances,
+                                       int maxResults, ShardFn scanShard, PrefixFn prefixDone) {
+    std::vector<Match> out;
+    minAdvances = std::max<int64_t>(minAdvances, 0);
+    if (maxAdvances < minAdvances) return out;
+    const size_t quota = (size_t)std::max(maxResults, 1);
+
+    const unsigned threads = scan_thread_count();
+    const uint64_t span = (uint64_t)(maxAdvances - minAdvances) + 1u;
+    const uint64_t shardSize = std::clamp<uint64_t>(span / ((uint64_t)threads * 16u),
+                                                    uint64_t(1) << 16, uint64_t(1) << 22);
+    const size_t shardCount = (size_t)((span + shardSize - 1) / shardSize);
+
+    std::vector<std::vector<Match>> shardResults(shardCount);
+    std::vector<bool> shardDone(shardCount, false);
+    std::atomic<size_t> cancelAbove{shardCount};
+    std::atomic<size_t> nextShard{0};
+    std::mutex doneMutex;
+    size_t donePrefix = 0;
+    size_t donePrefixMatches = 0;
+    const ScanAbort *abort = scan_abort;
+    QueryStats *stats = scan_stats;
+    const bool report = scan_progress && span >= SCAN_PROGRESS_MIN;
+    const auto started = std::chrono::steady_clock::now();
+    if (stats) {
+        std::lock_guard<std::mutex> lock(stats->mutex);
+        if (stats->scans++ == 0) {
+            stats->firstScan = started;
+            stats->firstScanCpu = std::clock();
+        }
+    }
+    auto lastReport = started;
+    uint64_t scanned = 0;
+    auto mega = [](double n) { return (uint64_t)(n / 1e6); };
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t idx = nextShard.fetch_add(1, std::memory_order_relaxed);
+            if (idx >= shardCount || idx > cancelAbove.load(std::memory_order_relaxed)) return;
+            if (abort && abort->aborted()) return;
+
+            const auto shardStarted = stats ? std::chrono::steady_clock::now() : started;
+            ScanShard shard;
+            shard.index = idx;
+            shard.first = minAdvances + (int64_t)(idx * shardSize);
+            shard.last = std::min<int64_t>(shard.first + (int64_t)shardSize - 1, maxAdvances);
+            shard.seed = startSeed;
+            rng_advance(shard.seed, backend, (uint64_t)shard.first);
+            shard.cancelAbove = &cancelAbove;
+            shard.abort = abort;
+            ScanTally tally;
+            if (stats) shard.tally = &tally;
+
+            const auto seeked = stats ? std::chrono::steady_clock::now() : started;
+            std::vector<Match> found;
+            scanShard(shard, found);
+
+            if (stats) {
+                const auto scanned = std::chrono::steady_clock::now();
+                tally.jumps++;
+                std::lock_guard<std::mutex> lock(stats->mutex);
+                stats->tally.add(tally);
+                stats->advances += (uint64_t)(shard.last - shard.first) + 1u;
+                stats->seekSeconds += std::chrono::duration<double>(seeked - shardStarted).count();
+                stats->scanSeconds += std::chrono::duration<double>(scanned - seeked).count();
+            }
 
-        if (verbose) {
-            std::cout << "rand#" << (i + 1)
-                      << " = 0x" << std::hex << std::uppercase << (uint32_t)r
-                      << std::dec
-                      << ", size=" << size
-                      << ", idx=" << idx
-                      << ", digit=" << digit << "\n";
+            std::lock_guard<std::mutex> lock(doneMutex);
+            size_t cutoff = cancelAbove.load(std::memory_order_relaxed);
+            if (found.size() >= quota) cutoff = std::min(cutoff, idx);
+            shardResults[idx] = std::move(found);
+            shardDone[idx] = true;
+            while (donePrefix < shardCount && shardDone[donePrefix]) {
+                donePrefixMatches += shardResults[donePrefix].size();
+                if (donePrefixMatches >= quota || prefixDone(shardResults[donePrefix])) {
+                    cutoff = std::min(cutoff, donePrefix);
+                }
+                ++donePrefix;
+            }
+            cancelAbove.store(cutoff, std::memory_order_relaxed);
+
+            if (report) {
+                scanned += (uint64_t)(shard.last - shard.first) + 1u;
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastReport >= std::chrono::seconds(1)) {
+                    lastReport = now;
+                    const double secs = std::chrono::duration<double>(now - started).count();
+                    std::cerr << "\rScanned " << mega((double)scanned) << "M / " << mega((double)span) << "M advances ("
+                              << std::fixed << std::setprecision(1) << 100.0 * (double)scanned / (double)span << "%, "
+                              << mega((double)scanned / secs) << "M/s)   " << std::flush;
+                }
+            }
         }
+    };
 
-        pool.erase(pool.begin() + idx);
+    if (threads == 1 || shardCount == 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        unsigned spawn = (unsigned)std::min<size_t>(threads, shardCount);
+        pool.reserve(spawn);
+        for (unsigned t = 0; t < spawn; ++t) pool.emplace_back(worker);
+        for (auto &th : pool) th.join();
+    }
+    if (report) {
+        const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::cerr << "\rScanned " << mega((double)scanned) << "M advances in " << std::fixed << std::setprecision(1)
+                  << secs << "s (" << mega((double)scanned / std::max(secs, 1e-9)) << "M/s)              \n";
     }
 
-    return code4;
+    const size_t cutoff = cancelAbove.load();
+    for (size_t idx = 0; idx < shardCount && idx <= cutoff && out.size() < quota; ++idx) {
+        for (const Match &m : shardResults[idx]) {
+            out.push_back(m);
+            if (out.size() >= quota) break;
+        }
+    }
+    if (stats) {
+        const auto ended = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(stats->mutex);
+        stats->scanWallSeconds += std::chrono::duration<double>(ended - started).count();
+        stats->lastScanEnd = ended;
+    }
+    return out;
 }
 
-uint32_t gen_clock_puzzle(uint32_t seed, int warmupAfterReset, uint8_t modeByte, RngBackend backend, bool verbose=false) {
-    rng_advance(seed, backend, warmupAfterReset);
+template <typename Match, typename ShardFn>
+static std::vector<Match> scan_sharded(uint32_t startSeed, RngBackend backend,
+                                       int64_t minAdvances, int64_t maxAdvances,
+                                       int maxResults, ShardFn scanShard) {
+    return scan_sharded<Match>(startSeed, backend, minAdvances, maxAdvances, maxResults, scanShard,
+                               [](const std::vector<Match> &) { return false; });
+}
 
-    uint32_t rHour = rng_next31(seed, backend);
-    int hour;
-    if (modeByte == 2) {
-        hour = static_cast<int>(rHour % 12) + 12;
-    } else {
-        hour = static_cast<int>(rHour % 12) + 1;
+// Lane kernels: the scanners read one shared rand31 output stream, filled
+// STREAM_BLOCK outputs at a time by SIMD_LANES lanes holding consecutive
+// states that move forward with a precomputed stride map. A window kernel
+// then evaluates the puzzle at every advance of the block from that stream,
+// SIMD_LANES windows per step, and returns only a bitmask of matching lanes
+// per step. The loops are written over fixed-size lane arrays so the
+// compiler turns them into vector code; on x86-64 GCC the kernels are cloned
+// for AVX-512 and AVX2 with a scalar default picked at load time.
+static constexpr int SIMD_LANES = 16;
+static constexpr int STREAM_BLOCK = SIMD_LANES * 16;
+static constexpr int STREAM_GROUPS = STREAM_BLOCK / SIMD_LANES;
+// Longest window: four crematorium draws plus the forced-7 position draw.
+static constexpr int STREAM_WINDOW = 5;
+static constexpr int STREAM_SPAN = STREAM_BLOCK + STREAM_WINDOW - 1;
+static constexpr uint32_t DRAW_TUPLE_NONE = 0xFFFFFFFFu;
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define SH3_SIMD_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SH3_SIMD_KERNEL
+#endif
+
+// Draws STREAM_BLOCK consecutive rand31 values: states[k] receives the state
+// before draw k and outputs[k] the value drawn. The lanes end up positioned
+// for the next block.
+template <typename Backend>
+static SH3_ALWAYS_INLINE void lanes_generate_impl(uint32_t *SH3_RESTRICT lanes, uint32_t *SH3_RESTRICT states,
+                                                  uint32_t *SH3_RESTRICT outputs, LcgAffine stride) {
+    const uint32_t strideMul = stride.mul;
+    const uint32_t strideAdd = stride.add;
+    for (int g = 0; g < STREAM_GROUPS; ++g) {
+        uint32_t *st = states + g * SIMD_LANES;
+        uint32_t *o = outputs + g * SIMD_LANES;
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            uint32_t s = lanes[j];
+            st[j] = s;
+            uint32_t next = s;
+            o[j] = Backend::next31(next);
+            lanes[j] = (s * strideMul + strideAdd) & Backend::stateMask;
+        }
     }
+}
 
-    int h_tens = hour / 10;
-    int h_ones = hour % 10;
+SH3_SIMD_KERNEL static void lanes_generate_ps2(uint32_t *SH3_RESTRICT lanes, uint32_t *SH3_RESTRICT states,
+                                               uint32_t *SH3_RESTRICT outputs, LcgAffine stride) {
+    lanes_generate_impl<Ps2Backend>(lanes, states, outputs, stride);
+}
 
-    uint32_t packed = (static_cast<uint32_t>(h_tens) << 12) |
-                      (static_cast<uint32_t>(h_ones) << 8);
+SH3_SIMD_KERNEL static void lanes_generate_pc(uint32_t *SH3_RESTRICT lanes, uint32_t *SH3_RESTRICT states,
+                                              uint32_t *SH3_RESTRICT outputs, LcgAffine stride) {
+    lanes_generate_impl<PcBackend>(lanes, states, outputs, stride);
+}
 
-    if (verbose) {
-        std::cout << "Hour RNG  = 0x" << std::hex << std::uppercase << rHour << std::dec
-                  << " -> hour=" << hour
-                  << " (tens=" << h_tens << ", ones=" << h_ones << ")\n";
+template <typename Backend>
+static SH3_ALWAYS_INLINE void lanes_generate(uint32_t *lanes, uint32_t *states, uint32_t *outputs, LcgAffine stride) {
+    if constexpr (Backend::id == RngBackend::PS2) lanes_generate_ps2(lanes, states, outputs, stride);
+    else                                          lanes_generate_pc(lanes, states, outputs, stride);
+}
+
+// PS2 only: lanes hold states PS2_SIEVE advances apart, so lane j of group g
+// sits at advance offset + PS2_SIEVE * (g * SIMD_LANES + j) of the block.
+// states[row] receives that state and draws[d * STREAM_BLOCK + row] the
+// (d+1)-th value drawn from it; Draws covers the longest window needed.
+static constexpr int PS2_SIEVE = 8;
+// Above this many live offsets the sieved lanes (one window per candidate)
+// cost more than drawing the shared stream once per advance.
+static constexpr int PS2_SIEVE_MAX_OFFSETS = 4;
+
+template <int Draws>
+static SH3_ALWAYS_INLINE void lanes_generate_sieved_impl(uint32_t *SH3_RESTRICT lanes,
+                                                         uint32_t *SH3_RESTRICT states,
+                                                         uint32_t *SH3_RESTRICT draws, LcgAffine stride) {
+    const uint32_t strideMul = stride.mul;
+    const uint32_t strideAdd = stride.add;
+    for (int g = 0; g < STREAM_GROUPS; ++g) {
+        uint32_t *st = states + g * SIMD_LANES;
+        uint32_t *dr = draws + g * SIMD_LANES;
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            uint32_t s = lanes[j];
+            st[j] = s;
+            lanes[j] = (s * strideMul + strideAdd) & 0x7FFFFFFFu;
+            for (int d = 0; d < Draws; ++d) {
+                s = (s * PS2_ADVANCE.mul + PS2_ADVANCE.add) & 0x7FFFFFFFu;
+                dr[d * STREAM_BLOCK + j] = s;
+            }
+        }
     }
+}
 
-    uint32_t rMin = rng_next31(seed, backend);
-    int minute = static_cast<int>(rMin % 60);
+SH3_SIMD_KERNEL static void lanes_generate_sieved2(uint32_t *SH3_RESTRICT lanes, uint32_t *SH3_RESTRICT states,
+                                                   uint32_t *SH3_RESTRICT draws, LcgAffine stride) {
+    lanes_generate_sieved_impl<2>(lanes, states, draws, stride);
+}
 
-    int m_tens = minute / 10;
-    int m_ones = minute % 10;
+SH3_SIMD_KERNEL static void lanes_generate_sieved5(uint32_t *SH3_RESTRICT lanes, uint32_t *SH3_RESTRICT states,
+                                                   uint32_t *SH3_RESTRICT draws, LcgAffine stride) {
+    lanes_generate_sieved_impl<STREAM_WINDOW>(lanes, states, draws, stride);
+}
 
-    packed |= (static_cast<uint32_t>(m_tens) << 4) |
-              (static_cast<uint32_t>(m_ones));
+static SH3_ALWAYS_INLINE uint32_t lanes_mask(const uint32_t *hit) {
+    uint32_t mask = 0;
+    for (int j = 0; j < SIMD_LANES; ++j) mask |= hit[j] << j;
+    return mask;
+}
 
-    if (verbose) {
-        std::cout << "Min RNG   = 0x" << std::hex << std::uppercase << rMin << std::dec
-                  << " -> minute=" << minute
-                  << " (tens=" << m_tens << ", ones=" << m_ones << ")\n";
+// Leading stages of a residue predicate, evaluated in lanes. d0[k] and d1[k]
+// are the first and second draws of window k (o and o + 1 on the shared
+// stream). Lane j passes when bit (d0[j] % M0) of `first` is set and, for
+// two-stage kernels, bit (d1[j] % M1) of `second`. Both reductions are multiply-highs, so most
+// advances are rejected after a couple of multiplies.
+template <uint32_t M0>
+static SH3_ALWAYS_INLINE void lanes_stage1_impl(const uint32_t *d0, uint32_t *masks, uint64_t first) {
+    const uint32_t lo = (uint32_t)first;
+    const uint32_t hi = (uint32_t)(first >> 32);
+    for (int g = 0; g < STREAM_GROUPS; ++g) {
+        const uint32_t *og = d0 + g * SIMD_LANES;
+        uint32_t hit[SIMD_LANES];
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            uint32_t r = og[j] % M0;
+            uint32_t word = (r < 32) ? lo : hi;
+            hit[j] = (word >> (r & 31)) & 1u;
+        }
+        masks[g] = lanes_mask(hit);
     }
+}
 
-    return packed;
+template <uint32_t M0, uint32_t M1>
+static SH3_ALWAYS_INLINE void lanes_stage2_impl(const uint32_t *d0, const uint32_t *d1, uint32_t *masks,
+                                                uint64_t first, uint64_t second) {
+    const uint32_t lo = (uint32_t)first;
+    const uint32_t hi = (uint32_t)(first >> 32);
+    const uint32_t secondLo = (uint32_t)second;
+    const uint32_t secondHi = (uint32_t)(second >> 32);
+    for (int g = 0; g < STREAM_GROUPS; ++g) {
+        const uint32_t *og0 = d0 + g * SIMD_LANES;
+        const uint32_t *og1 = d1 + g * SIMD_LANES;
+        uint32_t hit[SIMD_LANES];
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            uint32_t r0 = og0[j] % M0;
+            uint32_t r1 = og1[j] % M1;
+            uint32_t word0 = (r0 < 32) ? lo : hi;
+            uint32_t word1 = (r1 < 32) ? secondLo : secondHi;
+            hit[j] = (word0 >> (r0 & 31)) & (word1 >> (r1 & 31)) & 1u;
+        }
+        masks[g] = lanes_mask(hit);
+    }
 }
 
-struct ClockWarmupMatch {
-    int warmup;
-    uint32_t seedAfterWarmup;
-    uint32_t rHour;
-    uint32_t rMin;
-    uint32_t packed;
-};
+SH3_SIMD_KERNEL static void lanes_stage1_mod12(const uint32_t *d0, uint32_t *masks, uint64_t first) {
+    lanes_stage1_impl<12>(d0, masks, first);
+}
 
-std::vector<ClockWarmupMatch> find_clock_warmups(uint32_t baseSeed, uint8_t modeByte,
-                                               int targetHour, int targetMinute,
-                                               RngBackend backend,
-                                               int minWarmup = 0, int maxWarmup = 5000, int maxResults = 50) {
-    std::vector<ClockWarmupMatch> matches;
-    uint32_t targetPacked = ((targetHour / 10) << 12) | ((targetHour % 10) << 8) |
-                            ((targetMinute / 10) << 4) | (targetMinute % 10);
+SH3_SIMD_KERNEL static void lanes_stage1_mod60(const uint32_t *d0, uint32_t *masks, uint64_t first) {
+    lanes_stage1_impl<60>(d0, masks, first);
+}
+
+SH3_SIMD_KERNEL static void lanes_stage2_mod10_9(const uint32_t *d0, const uint32_t *d1, uint32_t *masks,
+                                                 uint64_t first, uint64_t second) {
+    lanes_stage2_impl<10, 9>(d0, d1, masks, first, second);
+}
+
+SH3_SIMD_KERNEL static void lanes_stage2_mod9_8(const uint32_t *d0, const uint32_t *d1, uint32_t *masks,
+                                                uint64_t first, uint64_t second) {
+    lanes_stage2_impl<9, 8>(d0, d1, masks, first, second);
+}
 
-    uint32_t seedWarm = baseSeed;
+SH3_SIMD_KERNEL static void lanes_stage2_mod12_60(const uint32_t *d0, const uint32_t *d1, uint32_t *masks,
+                                                  uint64_t first, uint64_t second) {
+    lanes_stage2_impl<12, 60>(d0, d1, masks, first, second);
+}
 
-    for (int i = 0; i < minWarmup; ++i) {
-        rng_next31(seedWarm, backend);
+// Walks one shard's rand31 stream a block at a time. Every rand31 of the
+// shard is drawn exactly once into a sliding buffer: outputs[k] is the
+// value drawn from states[k], the state after base + k advances, and the
+// last STREAM_WINDOW - 1 entries carry over to the next block.
+// block(base, outputs, states) sees the STREAM_BLOCK windows starting at
+// advance base and returns false to stop early.
+template <typename Backend, typename BlockFn>
+static void stream_shard_blocks(const ScanShard &shard, BlockFn block) {
+    uint32_t outputs[STREAM_SPAN];
+    uint32_t states[STREAM_SPAN];
+    uint32_t lanes[SIMD_LANES];
+
+    uint32_t seed = shard.seed;
+    for (int k = 0; k < STREAM_WINDOW - 1; ++k) {
+        states[k] = seed;
+        outputs[k] = Backend::next31(seed);
+    }
+    for (int j = 0; j < SIMD_LANES; ++j) {
+        lanes[j] = seed;
+        Backend::next31(seed);
+    }
+    const LcgAffine stride = rng_jump(Backend::id, SIMD_LANES);
+    if (shard.tally) {
+        shard.tally->draws += STREAM_WINDOW - 1 + SIMD_LANES;
+        shard.tally->jumps++;
     }
 
-    for (int w = minWarmup; w <= maxWarmup; ++w) {
-        uint32_t seed = seedWarm;
-        uint32_t seedAfterWarmup = seedWarm;
+    for (int64_t base = shard.first; base <= shard.last; base += STREAM_BLOCK) {
+        if (((base - shard.first) & SCAN_CANCEL_CHECK_MASK) < STREAM_BLOCK && shard.cancelled()) return;
+
+        lanes_generate<Backend>(lanes, states + STREAM_WINDOW - 1, outputs + STREAM_WINDOW - 1, stride);
+        if (shard.tally) shard.tally->draws += STREAM_BLOCK;
+        if (!block(base, (const uint32_t *)outputs, (const uint32_t *)states)) return;
+
+        for (int k = 0; k < STREAM_WINDOW - 1; ++k) {
+            outputs[k] = outputs[STREAM_BLOCK + k];
+            states[k] = states[STREAM_BLOCK + k];
+        }
+    }
+}
 
-        uint32_t rHour = rng_next31(seed, backend);
-        int hour = (modeByte == 2) ? (int)(rHour % 12) + 12
-                                   : (int)(rHour % 12) + 1;
-        int h_tens = hour / 10, h_ones = hour % 10;
-        uint32_t packed = ((uint32_t)h_tens << 12) | ((uint32_t)h_ones << 8);
+// Runs a window kernel over one shard's stream.
+// laneMatch(outputs, masks) fills one lane mask per group of the block;
+// emit(adv, seedAfterWarmup, out) records one match.
+template <typename Backend, typename Match, typename LaneMatchFn, typename EmitFn>
+static void scan_shard_lanes(const ScanShard &shard, int maxResults, std::vector<Match> &out,
+                             LaneMatchFn laneMatch, EmitFn emit) {
+    uint32_t masks[STREAM_GROUPS];
+    stream_shard_blocks<Backend>(shard, [&](int64_t base, const uint32_t *outputs, const uint32_t *states) {
+        laneMatch(outputs, masks);
+        for (int g = 0; g < STREAM_GROUPS; ++g) {
+            uint32_t mask = masks[g];
+            while (mask) {
+                int j = __builtin_ctz(mask);
+                mask &= mask - 1;
+                int64_t adv = base + g * SIMD_LANES + j;
+                if (adv > shard.last) return false;
+                emit(adv, states[g * SIMD_LANES + j], out);
+                if (shard.tally) shard.tally->matches++;
+                if ((int)out.size() >= maxResults) return false;
+            }
+        }
+        return true;
+    });
+}
 
-        uint32_t rMin = rng_next31(seed, backend);
-        int minute = (int)(rMin % 60);
-        int m_tens = minute / 10, m_ones = minute % 10;
-        packed |= ((uint32_t)m_tens << 4) | (uint32_t)m_ones;
+// Decode tables indexed by the mixed-radix draw tuple
+// ((i1 * (N-1) + i2) * (N-2) + i3) * (N-3) + i4, where ik is the k-th draw
+// reduced mod the pool size at that point. Each entry is the packed nibble
+// code the pool-removal loop would produce, so decoding is one lookup.
+static constexpr size_t SHAKESPEARE_TUPLES = 10 * 9 * 8 * 7;
+static constexpr size_t HOSPITAL3F_TUPLES  = 9 * 8 * 7 * 6;
+
+template <size_t Count>
+static constexpr std::array<uint16_t, Count> make_code_table(int firstDigit, int poolSize) {
+    std::array<uint16_t, Count> table{};
+    for (size_t tuple = 0; tuple < Count; ++tuple) {
+        int idx[4] = {};
+        size_t rest = tuple;
+        for (int i = 3; i >= 0; --i) {
+            size_t size = (size_t)(poolSize - i);
+            idx[i] = (int)(rest % size);
+            rest /= size;
+        }
 
-        if (packed == targetPacked) {
-            matches.push_back({w, seedAfterWarmup, rHour, rMin, packed});
-            if ((int)matches.size() >= maxResults) break;
+        int pool[10] = {};
+        for (int i = 0; i < poolSize; ++i) pool[i] = firstDigit + i;
+        int size = poolSize;
+        uint32_t code = 0;
+        for (int i = 0; i < 4; ++i) {
+            code = (code << 4) | (uint32_t)pool[idx[i]];
+            for (int j = idx[i]; j < size - 1; ++j) pool[j] = pool[j + 1];
+            size--;
         }
+        table[tuple] = (uint16_t)code;
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, SHAKESPEARE_TUPLES> SHAKESPEARE_CODES =
+    make_code_table<SHAKESPEARE_TUPLES>(0, 10);
+static constexpr std::array<uint16_t, HOSPITAL3F_TUPLES> HOSPITAL3F_CODES =
+    make_code_table<HOSPITAL3F_TUPLES>(1, 9);
+
+// Crematorium decode for a 0-9 draw tuple: forced[pos] is the final code when
+// the fifth draw picks pos (LSB-based) for the guaranteed 7. Tuples that
+// already drew a 7 have no fifth draw and all four entries equal the code.
+struct CrematoriumDecode {
+    uint16_t forced[4];
+    bool has7;
+};
 
-        rng_next31(seedWarm, backend);
+static constexpr std::array<CrematoriumDecode, SHAKESPEARE_TUPLES> make_crematorium_table() {
+    std::array<CrematoriumDecode, SHAKESPEARE_TUPLES> table{};
+    for (size_t tuple = 0; tuple < SHAKESPEARE_TUPLES; ++tuple) {
+        uint32_t code = SHAKESPEARE_CODES[tuple];
+        bool has7 = false;
+        for (int pos = 0; pos < 4; ++pos) {
+            if (((code >> (4 * pos)) & 0xF) == 7) has7 = true;
+        }
+        table[tuple].has7 = has7;
+        for (int pos = 0; pos < 4; ++pos) {
+            uint32_t shift = (uint32_t)(pos * 4);
+            table[tuple].forced[pos] = (uint16_t)(has7 ? code : ((code & ~(0xFu << shift)) | (7u << shift)));
+        }
     }
+    return table;
+}
 
-    return matches;
+static constexpr std::array<CrematoriumDecode, SHAKESPEARE_TUPLES> CREMATORIUM_CODES = make_crematorium_table();
+
+// Draws four values from `seed` and returns their mixed-radix tuple for an
+// N-digit pool.
+template <uint32_t N, typename Backend>
+static inline uint32_t draw_tuple(uint32_t &seed) {
+    uint32_t tuple = Backend::next31(seed) % N;
+    tuple = tuple * (N - 1) + Backend::next31(seed) % (N - 1);
+    tuple = tuple * (N - 2) + Backend::next31(seed) % (N - 2);
+    return tuple * (N - 3) + Backend::next31(seed) % (N - 3);
 }
 
-std::vector<ClockWarmupMatch> find_clock_warmups_flexible(uint32_t baseSeed, uint8_t modeByte,
-                                                       RngBackend backend,
-                                                       bool matchHour, bool matchMinute,
-                                                       int targetHour, int targetMinute,
-                                                       int minWarmup = 0, int maxWarmup = 5000, int maxResults = 50) {
-    std::vector<ClockWarmupMatch> matches;
+template <uint32_t N>
+static inline uint32_t draw_tuple(uint32_t &seed, RngBackend backend) {
+    return with_backend(backend, [&](auto policy) { return draw_tuple<N, decltype(policy)>(seed); });
+}
+
+// Draw tuple that decodes to codePacked from the pool firstDigit..firstDigit+poolSize-1.
+static uint32_t encode_draw_tuple(uint32_t codePacked, int firstDigit, int poolSize) {
+    if (codePacked > 0xFFFFu) return DRAW_TUPLE_NONE;
+    std::array<int, 10> pool{};
+    for (int i = 0; i < poolSize; ++i) pool[i] = firstDigit + i;
+    int size = poolSize;
+    uint32_t tuple = 0;
+    for (int i = 0; i < 4; ++i) {
+        int digit = (int)((codePacked >> (12 - 4 * i)) & 0xF);
+        int idx = -1;
+        for (int j = 0; j < size; ++j) {
+            if (pool[j] == digit) { idx = j; break; }
+        }
+        if (idx < 0) return DRAW_TUPLE_NONE;
+        tuple = tuple * (uint32_t)size + (uint32_t)idx;
+        for (int j = idx; j < size - 1; ++j) pool[j] = pool[j + 1];
+        size--;
+    }
+    return tuple;
+}
+
+// A reverse query compiled into a cascade of per-draw residue checks.
+// stageMasks[k] holds, for every prefix of earlier residues (mixed-radix,
+// like the draw tuples), the residues draw k may take without ruling out
+// every accepted outcome. A candidate is dropped at the first draw that
+// fails, so for an exact code most advances are rejected by draw 1.
+struct ResiduePredicate {
+    int draws = 0;
+    uint32_t moduli[4] = {};
+    uint64_t reciprocals[4] = {};
+    std::vector<uint64_t> stageMasks[4];
+    // Crematorium only: accepted forced-7 positions (bit per LSB-based
+    // position) for each 7-less draw tuple, checked against the fifth draw.
+    std::vector<uint8_t> forcedPosMask;
+    // Union of stageMasks[1] over every first residue. The lane kernels
+    // test the second draw against it without a per-lane table lookup.
+    uint64_t secondAny = 0;
+
+    bool empty() const { return draws > 0 && stageMasks[0][0] == 0; }
+};
+
+// x % m through a precomputed 64-bit reciprocal (Lemire's fastmod), so the
+// cascade's runtime moduli cost two multiplies instead of a divide.
+static inline uint64_t fastmod_reciprocal(uint32_t m) {
+    return UINT64_MAX / m + 1;
+}
 
-    uint32_t seedWarm = baseSeed;
+static inline uint32_t fastmod_u32(uint32_t x, uint64_t reciprocal, uint32_t m) {
+    uint64_t lowbits = reciprocal * x;
+    return (uint32_t)(((unsigned __int128)lowbits * m) >> 64);
+}
 
-    for (int i = 0; i < minWarmup; ++i) {
-        rng_next31(seedWarm, backend);
+static ResiduePredicate make_residue_predicate(std::initializer_list<uint32_t> moduli) {
+    ResiduePredicate pred;
+    size_t prefixes = 1;
+    for (uint32_t m : moduli) {
+        pred.moduli[pred.draws] = m;
+        pred.reciprocals[pred.draws] = fastmod_reciprocal(m);
+        pred.stageMasks[pred.draws].assign(prefixes, 0);
+        prefixes *= m;
+        pred.draws++;
     }
+    return pred;
+}
 
-    for (int w = minWarmup; w <= maxWarmup; ++w) {
-        uint32_t seed = seedWarm;
-        uint32_t seedAfterWarmup = seedWarm;
+static void residue_predicate_accept_tuple(ResiduePredicate &pred, uint32_t tuple) {
+    uint32_t residues[4] = {};
+    for (int k = pred.draws - 1; k >= 0; --k) {
+        residues[k] = tuple % pred.moduli[k];
+        tuple /= pred.moduli[k];
+    }
+    uint32_t prefix = 0;
+    for (int k = 0; k < pred.draws; ++k) {
+        pred.stageMasks[k][prefix] |= uint64_t(1) << residues[k];
+        prefix = prefix * pred.moduli[k] + residues[k];
+    }
+    if (pred.draws >= 2) pred.secondAny |= uint64_t(1) << residues[1];
+}
 
-        uint32_t rHour = 0;
-        uint32_t rMin  = 0;
-        int hour = 0;
-        int minute = 0;
+// True when the window whose draws start at o[0] passes every stage. The
+// stages are folded without early exits: the caller only asks about
+// advances whose first draw already passed, and for those a data-dependent
+// branch per draw costs more than finishing the chain.
+static inline bool residue_predicate_accepts(const ResiduePredicate &pred, const uint32_t *o) {
+    uint32_t prefix = 0;
+    uint64_t ok = 1;
+    for (int k = 0; k < pred.draws; ++k) {
+        uint32_t r = fastmod_u32(o[k], pred.reciprocals[k], pred.moduli[k]);
+        ok &= pred.stageMasks[k][prefix] >> r;
+        prefix = prefix * pred.moduli[k] + r;
+    }
+    if (!pred.forcedPosMask.empty() && !CREMATORIUM_CODES[prefix].has7) {
+        ok &= (uint64_t)pred.forcedPosMask[prefix] >> (o[4] & 3u);
+    }
+    return ok & 1u;
+}
 
-        if (matchHour && !matchMinute) {
-            rHour = rng_next31(seed, backend);
-            hour = (modeByte == 2) ? (int)(rHour % 12) + 12
-                                   : (int)(rHour % 12) + 1;
-        } else if (!matchHour && matchMinute) {
-            rMin = rng_next31(seed, backend);
-            minute = (int)(rMin % 60);
-        } else {
-            rHour = rng_next31(seed, backend);
-            hour = (modeByte == 2) ? (int)(rHour % 12) + 12
-                                   : (int)(rHour % 12) + 1;
-            rMin = rng_next31(seed, backend);
-            minute = (int)(rMin % 60);
-        }
+// First stage that turns the window down (pred.draws for the forced-7
+// draw), for the stats; only asked about windows the predicate rejects.
+static int residue_predicate_reject_stage(const ResiduePredicate &pred, const uint32_t *o) {
+    uint32_t prefix = 0;
+    for (int k = 0; k < pred.draws; ++k) {
+        uint32_t r = o[k] % pred.moduli[k];
+        if (!((pred.stageMasks[k][prefix] >> r) & 1u)) return k;
+        prefix = prefix * pred.moduli[k] + r;
+    }
+    return pred.draws;
+}
 
-        bool ok = true;
-        if (matchHour && hour != targetHour) ok = false;
-        if (matchMinute && minute != targetMinute) ok = false;
+// Shakespeare (pool 0-9) or 3F hospital (pool 1-9): exactly one tuple.
+static ResiduePredicate compile_code_predicate(uint32_t targetCodePacked, int firstDigit, int poolSize) {
+    const uint32_t n = (uint32_t)poolSize;
+    ResiduePredicate pred = make_residue_predicate({n, n - 1, n - 2, n - 3});
+    uint32_t tuple = encode_draw_tuple(targetCodePacked, firstDigit, poolSize);
+    if (tuple != DRAW_TUPLE_NONE) residue_predicate_accept_tuple(pred, tuple);
+    return pred;
+}
 
-        int h_tens = hour / 10, h_ones = hour % 10;
-        int m_tens = minute / 10, m_ones = minute % 10;
-        uint32_t packed = ((uint32_t)h_tens << 12) | ((uint32_t)h_ones << 8) |
-                          ((uint32_t)m_tens << 4) | (uint32_t)m_ones;
+// A set of target codes for one puzzle, one bit per draw tuple (5040 for
+// Shakespeare, 3024 for the 3F hospital, and the Shakespeare-style tuple of
+// the final code for the crematorium).
+using CodeSet = std::bitset<SHAKESPEARE_TUPLES>;
+
+// Shakespeare (pool 0-9) or 3F hospital (pool 1-9): every tuple in the set.
+static ResiduePredicate compile_code_set_predicate(const CodeSet &targets, int poolSize) {
+    const uint32_t n = (uint32_t)poolSize;
+    ResiduePredicate pred = make_residue_predicate({n, n - 1, n - 2, n - 3});
+    for (uint32_t tuple = 0; tuple < (uint32_t)targets.size(); ++tuple) {
+        if (targets[tuple]) residue_predicate_accept_tuple(pred, tuple);
+    }
+    return pred;
+}
 
-        if (ok) {
-            matches.push_back({w, seedAfterWarmup, rHour, rMin, packed});
-            if ((int)matches.size() >= maxResults) break;
+// Crematorium: every tuple that draws a code in the set directly, plus
+// every 7-less tuple whose forced-7 rewrite lands in it for some fifth draw.
+static ResiduePredicate compile_crematorium_set_predicate(const CodeSet &targets) {
+    ResiduePredicate pred = make_residue_predicate({10, 9, 8, 7});
+    pred.forcedPosMask.assign(SHAKESPEARE_TUPLES, 0);
+    for (uint32_t tuple = 0; tuple < SHAKESPEARE_TUPLES; ++tuple) {
+        const CrematoriumDecode &decode = CREMATORIUM_CODES[tuple];
+        uint8_t posMask = 0;
+        for (int pos = 0; pos < 4; ++pos) {
+            uint32_t key = encode_draw_tuple(decode.forced[pos], 0, 10);
+            if (key != DRAW_TUPLE_NONE && targets[key]) posMask |= (uint8_t)(1u << pos);
         }
+        if (!posMask) continue;
+        if (!decode.has7) pred.forcedPosMask[tuple] = posMask;
+        residue_predicate_accept_tuple(pred, tuple);
+    }
+    return pred;
+}
+
+static ResiduePredicate compile_crematorium_predicate(uint32_t targetCodePacked) {
+    CodeSet targets;
+    uint32_t key = encode_draw_tuple(targetCodePacked, 0, 10);
+    if (key != DRAW_TUPLE_NONE) targets.set(key);
+    return compile_crematorium_set_predicate(targets);
+}
 
-        rng_next31(seedWarm, backend);
+static ResiduePredicate compile_clock_predicate(int hourRem, int minute, bool minuteFirst) {
+    const bool checkHour = hourRem >= 0;
+    const bool checkMinute = minute >= 0;
+    if (checkHour && checkMinute && !minuteFirst) {
+        ResiduePredicate pred = make_residue_predicate({12, 60});
+        if (hourRem < 12 && minute < 60) residue_predicate_accept_tuple(pred, (uint32_t)(hourRem * 60 + minute));
+        return pred;
     }
+    if (checkHour) {
+        ResiduePredicate pred = make_residue_predicate({12});
+        if (hourRem < 12) residue_predicate_accept_tuple(pred, (uint32_t)hourRem);
+        return pred;
+    }
+    if (checkMinute) {
+        ResiduePredicate pred = make_residue_predicate({60});
+        if (minute < 60) residue_predicate_accept_tuple(pred, (uint32_t)minute);
+        return pred;
+    }
+    return make_residue_predicate({});
+}
 
-    return matches;
+// Runs the leading stages in lanes over windows whose first two draws are
+// d0[k] and d1[k]; returns how many draws were checked.
+static int lanes_leading_stages(const ResiduePredicate &pred, const uint32_t *d0, const uint32_t *d1,
+                                uint32_t *masks) {
+    if (pred.draws == 0) {
+        for (int g = 0; g < STREAM_GROUPS; ++g) masks[g] = (uint32_t)((uint64_t(1) << SIMD_LANES) - 1u);
+        return 0;
+    }
+    const uint64_t first = pred.stageMasks[0][0];
+    if (pred.draws == 1) {
+        if (pred.moduli[0] == 12) lanes_stage1_mod12(d0, masks, first);
+        else                      lanes_stage1_mod60(d0, masks, first);
+        return 1;
+    }
+    const uint64_t second = pred.secondAny;
+    switch (pred.moduli[0]) {
+        case 9:  lanes_stage2_mod9_8(d0, d1, masks, first, second); break;
+        case 10: lanes_stage2_mod10_9(d0, d1, masks, first, second); break;
+        default: lanes_stage2_mod12_60(d0, d1, masks, first, second); break;
+    }
+    return 2;
 }
 
-std::optional<int> find_seed_distance(uint32_t baseSeed, uint32_t targetSeed, RngBackend backend, int maxSteps = 5000000) {
-    if (baseSeed == targetSeed) return 0;
-    uint32_t seed = baseSeed;
-    for (int n = 1; n <= maxSteps; ++n) {
-        rng_next31(seed, backend);
-        if (seed == targetSeed) return n;
+// Whether a window passing lanes_leading_stages passes the whole predicate.
+// secondAny is exact when only one first residue is accepted.
+static bool lanes_leading_stages_exact(const ResiduePredicate &pred) {
+    return pred.forcedPosMask.empty() && (pred.draws < 2 || __builtin_popcountll(pred.stageMasks[0][0]) == 1);
+}
+
+// Whether some accepted outcome agrees with draws whose low three bits are
+// low[0..]; walks the cascade from draw k under `prefix`. A draw reduced
+// mod m = 2^e * odd (e <= 3) keeps the draw's low e bits.
+static bool residue_predicate_fits_low_bits(const ResiduePredicate &pred, const uint32_t *low, int k,
+                                            uint32_t prefix) {
+    if (k == pred.draws) {
+        if (pred.forcedPosMask.empty() || CREMATORIUM_CODES[prefix].has7) return true;
+        return (pred.forcedPosMask[prefix] >> (low[k] & 3u)) & 1u;
+    }
+    const uint32_t m = pred.moduli[k];
+    const uint32_t lowMask = std::min<uint32_t>(m & (~m + 1u), PS2_SIEVE) - 1u;
+    for (uint64_t bits = pred.stageMasks[k][prefix]; bits; bits &= bits - 1) {
+        uint32_t r = (uint32_t)__builtin_ctzll(bits);
+        if ((r & lowMask) != (low[k] & lowMask)) continue;
+        if (residue_predicate_fits_low_bits(pred, low, k + 1, prefix * m + r)) return true;
     }
-    return std::nullopt;
+    return false;
 }
 
-static std::optional<uint32_t> parse_shakespeare_code_input(const std::string& s) {
-    std::string t;
-    t.reserve(s.size());
-    for (char ch : s) {
-        if (!std::isspace((unsigned char)ch)) t.push_back(ch);
+// PS2 sieve: bit c is set when advances c, c + 8, c + 16, ... from `seed`
+// can pass the predicate. Multiplier and increment are both odd, so the
+// state mod 8 (and with it the low bits of every draw) repeats every eight
+// advances; offsets whose low bits rule out every accepted outcome never
+// match, whatever the higher bits do.
+static uint32_t ps2_sieve_offsets(const ResiduePredicate &pred, uint32_t seed) {
+    uint32_t low[PS2_SIEVE + STREAM_WINDOW];
+    for (int i = 0; i < PS2_SIEVE + STREAM_WINDOW; ++i) low[i] = ps2_rand32_step(seed) & 7u;
+    uint32_t offsets = 0;
+    for (int c = 0; c < PS2_SIEVE; ++c) {
+        if (residue_predicate_fits_low_bits(pred, low + c, 0, 0)) offsets |= 1u << c;
     }
-    if (t.empty()) return std::nullopt;
+    return offsets;
+}
 
-    bool looksHex = false;
-    if (t.size() >= 2 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X')) looksHex = true;
-    for (char ch : t) {
-        if ((ch >= 'A' && ch <= 'F') || (ch >= 'a' && ch <= 'f')) {
-            looksHex = true;
-            break;
+// Drops lanes of `masks` whose window fails the full cascade; windowAt(row,
+// window) copies the draws of the window at `row` of the block.
+template <typename WindowFn>
+static SH3_ALWAYS_INLINE void lanes_filter_survivors(const ResiduePredicate &pred, uint32_t *masks,
+                                                     WindowFn windowAt, ScanTally *tally = nullptr) {
+    uint32_t window[STREAM_WINDOW];
+    for (int g = 0; g < STREAM_GROUPS; ++g) {
+        uint32_t pending = masks[g];
+        while (pending) {
+            int j = __builtin_ctz(pending);
+            pending &= pending - 1;
+            const uint32_t *w = windowAt(g * SIMD_LANES + j, window);
+            if (residue_predicate_accepts(pred, w)) continue;
+            masks[g] &= ~(1u << j);
+            if (tally) tally->rejected[residue_predicate_reject_stage(pred, w)]++;
         }
     }
+}
 
-    uint32_t packed = 0;
+// Counts a block's windows and what lanes_leading_stages turned down:
+// first[r] is the first draw of window r, and masks what passed `checked`
+// stages. The lanes test the second draw against secondAny, which only
+// rejects windows the exact stage would.
+static void stats_tally_leading(ScanTally &tally, const ResiduePredicate &pred, const uint32_t *first, int checked,
+                                const uint32_t *masks) {
+    tally.windows += STREAM_BLOCK;
+    if (checked == 0) return;
+    uint64_t passed = 0;
+    for (int r = 0; r < STREAM_BLOCK; ++r) passed += (pred.stageMasks[0][0] >> (first[r] % pred.moduli[0])) & 1u;
+    uint64_t survived = 0;
+    for (int g = 0; g < STREAM_GROUPS; ++g) survived += (uint64_t)__builtin_popcount(masks[g]);
+    tally.rejected[0] += STREAM_BLOCK - passed;
+    tally.rejected[1] += passed - survived;
+}
 
-    if (looksHex) {
-        size_t idx = 0;
-        if (t.size() >= 2 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X')) idx = 2;
-        if (t.size() - idx == 0 || t.size() - idx > 8) return std::nullopt;
+// PS2 scan over the sieved offsets only. Each offset gets its own lanes
+// stepping PS2_SIEVE advances at a time; a block covers
+// PS2_SIEVE * STREAM_BLOCK advances, and matches are emitted row by row,
+// offsets ascending, so they come out in advance order.
+template <typename Match, typename EmitFn>
+static void scan_shard_ps2_sieved(const ScanShard &shard, const ResiduePredicate &pred, uint32_t offsets,
+                                  bool lanesExact, int maxResults, std::vector<Match> &out, EmitFn emit) {
+    constexpr int64_t BLOCK_ADVANCES = (int64_t)PS2_SIEVE * STREAM_BLOCK;
+    int offsetList[PS2_SIEVE];
+    int offsetCount = 0;
+    for (int c = 0; c < PS2_SIEVE; ++c) {
+        if (offsets & (1u << c)) offsetList[offsetCount++] = c;
+    }
 
-        uint32_t val = 0;
-        for (; idx < t.size(); ++idx) {
-            char ch = t[idx];
-            int v = -1;
-            if (ch >= '0' && ch <= '9') v = ch - '0';
-            else if (ch >= 'A' && ch <= 'F') v = 10 + (ch - 'A');
-            else if (ch >= 'a' && ch <= 'f') v = 10 + (ch - 'a');
-            else return std::nullopt;
-            val = (val << 4) | (uint32_t)v;
+    uint32_t lanes[PS2_SIEVE][SIMD_LANES];
+    uint32_t states[PS2_SIEVE][STREAM_BLOCK];
+    uint32_t masks[PS2_SIEVE][STREAM_GROUPS];
+    uint32_t draws[STREAM_WINDOW * STREAM_BLOCK];
+
+    const LcgAffine row = rng_jump(RngBackend::PS2, PS2_SIEVE);
+    const LcgAffine stride = rng_jump(RngBackend::PS2, (uint64_t)PS2_SIEVE * SIMD_LANES);
+    if (shard.tally) shard.tally->jumps += 2 + offsetCount;
+    for (int i = 0; i < offsetCount; ++i) {
+        uint32_t s = shard.seed;
+        rng_advance(s, RngBackend::PS2, (uint64_t)offsetList[i]);
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            lanes[i][j] = s;
+            s = rng_apply(row, s, RngBackend::PS2);
         }
-        packed = val;
-    } else {
-        if (t.size() != 4) return std::nullopt;
-        packed = 0;
-        for (char ch : t) {
-            if (ch < '0' || ch > '9') return std::nullopt;
-            packed = (packed << 4) | (uint32_t)(ch - '0');
+    }
+    const bool shortWindow = pred.draws <= 2 && pred.forcedPosMask.empty();
+
+    for (int64_t base = shard.first; base <= shard.last; base += BLOCK_ADVANCES) {
+        if (((base - shard.first) & SCAN_CANCEL_CHECK_MASK) < BLOCK_ADVANCES && shard.cancelled()) return;
+
+        for (int i = 0; i < offsetCount; ++i) {
+            if (shortWindow) lanes_generate_sieved2(lanes[i], states[i], draws, stride);
+            else             lanes_generate_sieved5(lanes[i], states[i], draws, stride);
+            int checked = lanes_leading_stages(pred, draws, draws + STREAM_BLOCK, masks[i]);
+            if (shard.tally) {
+                shard.tally->draws += (uint64_t)STREAM_BLOCK * (shortWindow ? 2 : STREAM_WINDOW);
+                stats_tally_leading(*shard.tally, pred, draws, checked, masks[i]);
+            }
+            if (checked == pred.draws && lanesExact) continue;
+            lanes_filter_survivors(pred, masks[i], [&](int r, uint32_t *window) {
+                for (int d = 0; d < STREAM_WINDOW; ++d) window[d] = draws[d * STREAM_BLOCK + r];
+                return (const uint32_t *)window;
+            }, shard.tally);
+        }
+        if (shard.tally) shard.tally->sieved += (uint64_t)(PS2_SIEVE - offsetCount) * STREAM_BLOCK;
+
+        for (int g = 0; g < STREAM_GROUPS; ++g) {
+            uint32_t rows = 0;
+            for (int i = 0; i < offsetCount; ++i) rows |= masks[i][g];
+            while (rows) {
+                int j = __builtin_ctz(rows);
+                rows &= rows - 1;
+                const int r = g * SIMD_LANES + j;
+                for (int i = 0; i < offsetCount; ++i) {
+                    if (!((masks[i][g] >> j) & 1u)) continue;
+                    int64_t adv = base + (int64_t)r * PS2_SIEVE + offsetList[i];
+                    if (adv > shard.last) return;
+                    emit(adv, states[i][r], out);
+                    if (shard.tally) shard.tally->matches++;
+                    if ((int)out.size() >= maxResults) return;
+                }
+            }
         }
     }
+}
 
-    bool used[10] = {false};
-    for (int i = 0; i < 4; ++i) {
-        int digit = (packed >> (12 - 4 * i)) & 0xF;
-        if (digit < 0 || digit > 9) return std::nullopt;
-        if (used[digit]) return std::nullopt;
-        used[digit] = true;
+// Scans one shard with a compiled predicate: the first two draws are
+// checked in lanes (the second only against secondAny), and the few
+// survivors walk the whole cascade. On PS2 the low-bit sieve first picks
+// the advance offsets mod 8 that can match at all; when it leaves few of
+// them only those are stepped through.
+template <typename Match, typename EmitFn>
+static void scan_shard_predicate(const ScanShard &shard, RngBackend backend, const ResiduePredicate &pred,
+                                 int maxResults, std::vector<Match> &out, EmitFn emit) {
+    const bool lanesExact = lanes_leading_stages_exact(pred);
+    if (backend == RngBackend::PS2) {
+        const uint32_t offsets = ps2_sieve_offsets(pred, shard.seed);
+        if (!offsets) {
+            if (shard.tally) shard.tally->sieved += (uint64_t)(shard.last - shard.first) + 1u;
+            return;
+        }
+        if (__builtin_popcount(offsets) <= PS2_SIEVE_MAX_OFFSETS) {
+            scan_shard_ps2_sieved(shard, pred, offsets, lanesExact, maxResults, out, emit);
+            return;
+        }
     }
-
-    return packed;
+    with_backend(backend, [&](auto policy) {
+        scan_shard_lanes<decltype(policy)>(shard, maxResults, out,
+            [&](const uint32_t *o, uint32_t *masks) {
+                int checked = lanes_leading_stages(pred, o, o + 1, masks);
+                if (shard.tally) stats_tally_leading(*shard.tally, pred, o, checked, masks);
+                if (checked == pred.draws && lanesExact) return;
+                lanes_filter_survivors(pred, masks, [&](int r, uint32_t *) { return o + r; }, shard.tally);
+            },
+            emit);
+    });
 }
 
-struct ShakespeareMatch {
-    int advances;
-    uint32_t seedAfterWarmup;
-    uint32_t codePacked;
+// Advance index: for one backend and base seed (normally 0, the new-game
+// stream), the sorted advances [0, horizon) at which each Shakespeare,
+// 3F hospital and crematorium code comes up, one Elias-Fano posting list
+// per code. It is built offline with --build-index and memory-mapped by
+// reverse queries, which then binary-search the list instead of scanning.
+//
+// File layout (little-endian): AdvanceIndexHeader, the list directory,
+// then each list's words: low bits, high bits, skip samples. The header
+// checksum covers the directory; each list's checksum is checked the first
+// time that list is read, so opening a large index stays instant.
+enum class IndexPuzzle { Shakespeare, Hospital3F, Crematorium };
+
+static constexpr uint32_t INDEX_LIST_BASE[3] = {0, SHAKESPEARE_TUPLES, SHAKESPEARE_TUPLES + HOSPITAL3F_TUPLES};
+static constexpr uint32_t INDEX_LIST_COUNT = 2 * SHAKESPEARE_TUPLES + HOSPITAL3F_TUPLES;
+static constexpr char INDEX_MAGIC[8] = {'S', 'H', '3', 'I', 'D', 'X', '\0', '\0'};
+static constexpr uint32_t INDEX_VERSION = 1;
+// Every EF_SKIP-th element keeps its high-bit position, so a lookup decodes
+// at most EF_SKIP elements after its binary search.
+static constexpr uint64_t EF_SKIP = 256;
+static constexpr uint64_t INDEX_MAX_HORIZON = uint64_t(1) << 40;
+
+struct AdvanceIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t backend;      // 0 = PS2, 1 = PC
+    uint32_t baseSeed;
+    uint32_t listCount;
+    uint64_t horizon;
+    uint64_t checksum;
 };
 
-static inline uint32_t gen_shakespeare_code_from_seed(uint32_t seedAfterWarmup, RngBackend backend) {
-    std::array<int, 10> pool = {0,1,2,3,4,5,6,7,8,9};
-    int poolSize = 10;
-    uint32_t code4 = 0;
-
-    for (int i = 0; i < 4; ++i) {
-        int32_t r = (int32_t)rng_next31(seedAfterWarmup, backend);
-        int idx = r % poolSize;
-        if (idx < 0) idx += poolSize;
+struct AdvanceIndexList {
+    uint64_t count;
+    uint64_t offset;       // byte offset of the list's words
+    uint32_t lowBits;
+    uint32_t reserved;
+    uint64_t checksum;
+};
 
-        int digit = pool[idx];
-        code4 = (code4 << 4) | (uint32_t)digit;
+static_assert(sizeof(AdvanceIndexHeader) == 40, "index header layout");
+static_assert(sizeof(AdvanceIndexList) == 32, "index directory layout");
 
-        for (int j = idx; j < poolSize - 1; ++j) pool[j] = pool[j + 1];
-        poolSize--;
+static uint64_t index_checksum(const uint64_t *words, size_t count) {
+    uint64_t h = 0x84222325CBF29CE4ull;
+    for (size_t i = 0; i < count; ++i) {
+        h = (h ^ words[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
     }
+    return h;
+}
 
-    return code4;
+static uint32_t ef_low_bits(uint64_t count, uint64_t horizon) {
+    if (count == 0 || horizon <= count) return 0;
+    return (uint32_t)(63 - __builtin_clzll(horizon / count));
 }
 
-static std::vector<ShakespeareMatch> find_shakespeare_seeds_for_code(
-    uint32_t startSeed,
-    uint32_t targetCodePacked,
-    int maxResults,
-    RngBackend backend,
-    int minAdvances = 0,
-    int hardMaxAdvances = 10'000'000
-) {
-    std::vector<ShakespeareMatch> out;
-    out.reserve((size_t)maxResults);
+struct EliasFanoShape {
+    uint64_t lowWords, highWords, skipWords;
+    uint64_t words() const { return lowWords + highWords + skipWords; }
+};
 
-    uint32_t seedWarm = startSeed;
+static EliasFanoShape ef_shape(uint64_t count, uint32_t lowBits, uint64_t horizon) {
+    EliasFanoShape shape{0, 0, 0};
+    if (count == 0) return shape;
+    shape.lowWords = (count * lowBits + 63) / 64;
+    shape.highWords = (count + ((horizon - 1) >> lowBits) + 1 + 63) / 64;
+    shape.skipWords = (count + EF_SKIP - 1) / EF_SKIP;
+    return shape;
+}
+
+// Read-only view of one posting list.
+struct EliasFanoList {
+    const uint64_t *low = nullptr;
+    const uint64_t *high = nullptr;
+    const uint64_t *skip = nullptr;
+    uint64_t count = 0;
+    uint64_t skipCount = 0;
+    uint32_t lowBits = 0;
+
+    uint64_t low_at(uint64_t i) const {
+        if (lowBits == 0) return 0;
+        uint64_t bit = i * lowBits;
+        uint64_t w = bit >> 6;
+        uint32_t off = (uint32_t)(bit & 63);
+        uint64_t v = low[w] >> off;
+        if (off + lowBits > 64) v |= low[w + 1] << (64 - off);
+        return v & ((uint64_t(1) << lowBits) - 1);
+    }
+
+    // First set high bit at or after `pos`.
+    uint64_t next_high(uint64_t pos) const {
+        uint64_t w = pos >> 6;
+        uint64_t bits = high[w] & (~uint64_t(0) << (pos & 63));
+        while (!bits) bits = high[++w];
+        return (w << 6) + (uint64_t)__builtin_ctzll(bits);
+    }
+
+    uint64_t value(uint64_t i, uint64_t highPos) const {
+        return ((highPos - i) << lowBits) | low_at(i);
+    }
+
+    // Appends elements in [first, last] to `out` until it holds `quota`.
+    void collect(uint64_t first, uint64_t last, size_t quota, std::vector<uint64_t> &out) const {
+        if (count == 0 || out.size() >= quota) return;
+        // Last sample whose element is <= first (or sample 0).
+        uint64_t lo = 0, hi = skipCount;
+        while (hi - lo > 1) {
+            uint64_t mid = (lo + hi) / 2;
+            if (value(mid * EF_SKIP, skip[mid]) <= first) lo = mid;
+            else hi = mid;
+        }
+        uint64_t i = lo * EF_SKIP;
+        uint64_t pos = skip[lo];
+        for (;;) {
+            uint64_t v = value(i, pos);
+            if (v > last) return;
+            if (v >= first) {
+                out.push_back(v);
+                if (out.size() >= quota) return;
+            }
+            if (++i == count) return;
+            pos = next_high(pos + 1);
+        }
+    }
+};
+
+struct AdvanceIndex {
+    std::string path;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::vector<uint64_t> owned;        // file contents when mmap is unavailable
+    AdvanceIndexHeader header{};
+    const AdvanceIndexList *lists = nullptr;
+    std::unique_ptr<std::atomic<uint8_t>[]> listState;   // 0 unchecked, 1 ok, 2 corrupt
+
+#if defined(SH3_HAVE_MMAP)
+    ~AdvanceIndex() {
+        if (data && owned.empty()) munmap(const_cast<uint8_t *>(data), size);
+    }
+#endif
+
+    bool list(uint32_t listIndex, EliasFanoList &ef) const {
+        const AdvanceIndexList &entry = lists[listIndex];
+        const EliasFanoShape shape = ef_shape(entry.count, entry.lowBits, header.horizon);
+        const uint64_t *words = reinterpret_cast<const uint64_t *>(data + entry.offset);
+        uint8_t state = listState[listIndex].load(std::memory_order_acquire);
+        if (state == 0) {
+            state = index_checksum(words, shape.words()) == entry.checksum ? 1 : 2;
+            listState[listIndex].store(state, std::memory_order_release);
+            if (state != 1) std::cerr << "Advance index " << path << ": list " << listIndex << " is corrupt, scanning instead.\n";
+        }
+        if (state != 1) return false;
+        ef.low = words;
+        ef.high = words + shape.lowWords;
+        ef.skip = ef.high + shape.highWords;
+        ef.count = entry.count;
+        ef.skipCount = shape.skipWords;
+        ef.lowBits = entry.lowBits;
+        return true;
+    }
+};
+
+static bool index_fail(const std::string &path, const char *why) {
+    std::cerr << "Advance index " << path << " ignored: " << why << "\n";
+    return false;
+}
+
+static bool index_load(AdvanceIndex &index, const std::string &path, RngBackend backend) {
+    index.path = path;
+#if defined(SH3_HAVE_MMAP)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return index_fail(path, "cannot open file");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AdvanceIndexHeader)) {
+        close(fd);
+        return index_fail(path, "file too small");
+    }
+    void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return index_fail(path, "mmap failed");
+    index.data = static_cast<const uint8_t *>(mapped);
+    index.size = (size_t)st.st_size;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return index_fail(path, "cannot open file");
+    std::streamsize bytes = in.tellg();
+    if (bytes < (std::streamsize)sizeof(AdvanceIndexHeader)) return index_fail(path, "file too small");
+    index.owned.resize(((size_t)bytes + 7) / 8);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(index.owned.data()), bytes);
+    index.data = reinterpret_cast<const uint8_t *>(index.owned.data());
+    index.size = (size_t)bytes;
+#endif
+
+    std::memcpy(&index.header, index.data, sizeof(AdvanceIndexHeader));
+    const AdvanceIndexHeader &h = index.header;
+    if (std::memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) return index_fail(path, "not an index file");
+    if (h.version != INDEX_VERSION) return index_fail(path, "unsupported version");
+    if (h.backend != (backend == RngBackend::PS2 ? 0u : 1u)) return index_fail(path, "built for the other backend");
+    if (h.listCount != INDEX_LIST_COUNT || h.horizon == 0 || h.horizon > INDEX_MAX_HORIZON) {
+        return index_fail(path, "bad header");
+    }
+    const size_t dirBytes = sizeof(AdvanceIndexList) * h.listCount;
+    if (index.size < sizeof(AdvanceIndexHeader) + dirBytes) return index_fail(path, "truncated directory");
+    index.lists = reinterpret_cast<const AdvanceIndexList *>(index.data + sizeof(AdvanceIndexHeader));
+    if (index_checksum(reinterpret_cast<const uint64_t *>(index.lists), dirBytes / 8) != h.checksum) {
+        return index_fail(path, "directory checksum mismatch");
+    }
+    for (uint32_t i = 0; i < h.listCount; ++i) {
+        const AdvanceIndexList &entry = index.lists[i];
+        uint64_t words = ef_shape(entry.count, entry.lowBits, h.horizon).words();
+        if (entry.offset % 8 != 0 || entry.offset > index.size || words > (index.size - entry.offset) / 8) {
+            return index_fail(path, "truncated list data");
+        }
+    }
+    index.listState.reset(new std::atomic<uint8_t>[h.listCount]());
+    return true;
+}
+
+// The index for `backend`, opened on first use from the path in
+// SH3_INDEX_PS2 / SH3_INDEX_PC; null when unset or unusable.
+static const AdvanceIndex *advance_index(RngBackend backend) {
+    static std::once_flag once[2];
+    static std::unique_ptr<AdvanceIndex> loaded[2];
+    const int slot = (backend == RngBackend::PS2) ? 0 : 1;
+    std::call_once(once[slot], [&]() {
+        const char *path = std::getenv(slot == 0 ? "SH3_INDEX_PS2" : "SH3_INDEX_PC");
+        if (!path || !*path) return;
+        auto index = std::make_unique<AdvanceIndex>();
+        if (index_load(*index, path, backend)) loaded[slot] = std::move(index);
+    });
+    return loaded[slot].get();
+}
+
+// Reverse query for one code over [minAdvances, maxAdvances]. Advances the
+// index covers for (backend, startSeed) come from the posting list `key`
+// of `puzzle`; anything past its horizon, or the whole range without a
+// usable index, goes to scan(first, last, maxResults). emit(adv,
+// seedAfterWarmup, out) builds a match exactly as the scanner does.
+template <typename Match, typename EmitFn, typename ScanFn>
+static std::vector<Match> find_indexed(IndexPuzzle puzzle, uint32_t key, uint32_t startSeed, RngBackend backend,
+                                       int64_t minAdvances, int64_t maxAdvances, int maxResults,
+                                       EmitFn emit, ScanFn scan) {
+    minAdvances = std::max<int64_t>(minAdvances, 0);
+    const AdvanceIndex *index = advance_index(backend);
+    EliasFanoList ef;
+    if (!index || index->header.baseSeed != startSeed || maxAdvances < minAdvances ||
+        !index->list(INDEX_LIST_BASE[(int)puzzle] + key, ef)) {
+        return scan(minAdvances, maxAdvances, maxResults);
+    }
+
+    const size_t quota = (size_t)std::max(maxResults, 1);
+    const int64_t horizonLast = (int64_t)index->header.horizon - 1;
+    std::vector<uint64_t> advances;
+    if (minAdvances <= horizonLast) {
+        ef.collect((uint64_t)minAdvances, (uint64_t)std::min(maxAdvances, horizonLast), quota, advances);
+    }
+
+    std::vector<Match> out;
+    for (uint64_t adv : advances) {
+        uint32_t seed = startSeed;
+        rng_advance(seed, backend, adv);
+        emit((int64_t)adv, seed, out);
+    }
+    if (out.size() < quota && maxAdvances > horizonLast) {
+        std::vector<Match> tail = scan(std::max(minAdvances, horizonLast + 1), maxAdvances,
+                                       (int)(quota - out.size()));
+        out.insert(out.end(), tail.begin(), tail.end());
+    }
+    return out;
+}
+
+// Posting-list keys of the window o[0..4]: Shakespeare draw tuple, hospital
+// draw tuple and the crematorium code after any forced 7, as its tuple.
+struct IndexKeyTables {
+    std::vector<uint16_t> cremKey;    // [tuple * 4 + forced position]
+
+    IndexKeyTables() : cremKey(SHAKESPEARE_TUPLES * 4) {
+        for (uint32_t tuple = 0; tuple < SHAKESPEARE_TUPLES; ++tuple) {
+            for (int pos = 0; pos < 4; ++pos) {
+                cremKey[tuple * 4 + pos] = (uint16_t)encode_draw_tuple(CREMATORIUM_CODES[tuple].forced[pos], 0, 10);
+            }
+        }
+    }
+
+    void keys(const uint32_t *o, uint32_t *out) const {
+        uint32_t t10 = ((o[0] % 10 * 9 + o[1] % 9) * 8 + o[2] % 8) * 7 + o[3] % 7;
+        uint32_t t9 = ((o[0] % 9 * 8 + o[1] % 8) * 7 + o[2] % 7) * 6 + o[3] % 6;
+        uint32_t pos = CREMATORIUM_CODES[t10].has7 ? 0u : o[4] % 4u;
+        out[0] = INDEX_LIST_BASE[0] + t10;
+        out[1] = INDEX_LIST_BASE[1] + t9;
+        out[2] = INDEX_LIST_BASE[2] + cremKey[t10 * 4 + pos];
+    }
+};
+
+// Calls fn(adv, keys) for every advance in [first, last] from baseSeed.
+template <typename Fn>
+static void index_walk(const IndexKeyTables &tables, RngBackend backend, uint32_t baseSeed,
+                       uint64_t first, uint64_t last, Fn fn) {
+    uint32_t seed = baseSeed;
+    rng_advance(seed, backend, first);
+    with_backend(backend, [&](auto policy) {
+        using Backend = decltype(policy);
+        uint32_t o[STREAM_WINDOW];
+        for (int k = 0; k < STREAM_WINDOW; ++k) o[k] = Backend::next31(seed);
+        uint32_t keys[3];
+        for (uint64_t adv = first;; ++adv) {
+            tables.keys(o, keys);
+            fn(adv, keys);
+            if (adv == last) return;
+            for (int k = 0; k < STREAM_WINDOW - 1; ++k) o[k] = o[k + 1];
+            o[STREAM_WINDOW - 1] = Backend::next31(seed);
+        }
+    });
+}
+
+// Writable output of the builder: the file itself, mapped, where mmap is
+// available, so an index larger than memory can still be built.
+struct IndexOutput {
+    uint64_t *words = nullptr;
+    size_t bytes = 0;
+#if defined(SH3_HAVE_MMAP)
+    bool open(const std::string &path, size_t size) {
+        bytes = size;
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, (off_t)size) != 0) { ::close(fd); return false; }
+        void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        words = static_cast<uint64_t *>(mapped);
+        return true;
+    }
+    bool finish(const std::string &) {
+        bool ok = msync(words, bytes, MS_SYNC) == 0;
+        munmap(words, bytes);
+        return ok;
+    }
+#else
+    std::vector<uint64_t> buffer;
+    bool open(const std::string &, size_t size) {
+        bytes = size;
+        buffer.assign(size / 8, 0);
+        words = buffer.data();
+        return true;
+    }
+    bool finish(const std::string &path) {
+        std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+        outFile.write(reinterpret_cast<const char *>(words), (std::streamsize)bytes);
+        return (bool)outFile;
+    }
+#endif
+};
+
+static inline void index_or(uint64_t *words, uint64_t w, uint64_t bits) {
+    __atomic_fetch_or(&words[w], bits, __ATOMIC_RELAXED);
+}
+
+// Builds the index for advances [0, horizon) from baseSeed. Two passes over
+// the stream in parallel chunks: the first counts each code's postings, the
+// second writes every posting at its final rank, so each list comes out
+// sorted without holding the postings in memory.
+static bool build_advance_index(const std::string &path, RngBackend backend, uint32_t baseSeed,
+                                uint64_t horizon) {
+    const IndexKeyTables tables;
+    const unsigned threads = scan_thread_count();
+    const uint64_t chunkCount = std::min<uint64_t>(horizon, (uint64_t)threads * 8u);
+    const uint64_t chunkSize = (horizon + chunkCount - 1) / chunkCount;
+    std::vector<uint64_t> counts((size_t)(chunkCount * INDEX_LIST_COUNT), 0);
+
+    auto runChunks = [&](auto chunkFn) {
+        std::atomic<uint64_t> next{0};
+        auto worker = [&]() {
+            for (uint64_t c; (c = next.fetch_add(1)) < chunkCount;) {
+                uint64_t first = c * chunkSize;
+                if (first >= horizon) continue;
+                chunkFn(c, first, std::min(first + chunkSize, horizon) - 1);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+        worker();
+        for (auto &th : pool) th.join();
+    };
+
+    std::cout << "Pass 1/2: counting postings over " << horizon << " advances...\n";
+    runChunks([&](uint64_t c, uint64_t first, uint64_t last) {
+        uint64_t *chunkCounts = &counts[(size_t)(c * INDEX_LIST_COUNT)];
+        index_walk(tables, backend, baseSeed, first, last, [&](uint64_t, const uint32_t *keys) {
+            chunkCounts[keys[0]]++;
+            chunkCounts[keys[1]]++;
+            chunkCounts[keys[2]]++;
+        });
+    });
+
+    // Lay out the lists and turn per-chunk counts into starting ranks.
+    std::vector<AdvanceIndexList> dir(INDEX_LIST_COUNT);
+    uint64_t offset = sizeof(AdvanceIndexHeader) + sizeof(AdvanceIndexList) * INDEX_LIST_COUNT;
+    for (uint32_t i = 0; i < INDEX_LIST_COUNT; ++i) {
+        uint64_t total = 0;
+        for (uint64_t c = 0; c < chunkCount; ++c) {
+            uint64_t &slot = counts[(size_t)(c * INDEX_LIST_COUNT + i)];
+            uint64_t n = slot;
+            slot = total;
+            total += n;
+        }
+        AdvanceIndexList &entry = dir[i];
+        entry.count = total;
+        entry.lowBits = ef_low_bits(total, horizon);
+        entry.offset = offset;
+        offset += ef_shape(total, entry.lowBits, horizon).words() * 8;
+    }
+
+    IndexOutput output;
+    if (!output.open(path, (size_t)offset)) {
+        std::cout << "Cannot create " << path << "\n";
+        return false;
+    }
+    uint64_t *words = output.words;
+
+    std::cout << "Pass 2/2: writing " << offset << " bytes...\n";
+    runChunks([&](uint64_t c, uint64_t first, uint64_t last) {
+        uint64_t *rank = &counts[(size_t)(c * INDEX_LIST_COUNT)];
+        index_walk(tables, backend, baseSeed, first, last, [&](uint64_t adv, const uint32_t *keys) {
+            for (int k = 0; k < 3; ++k) {
+                const AdvanceIndexList &entry = dir[keys[k]];
+                const EliasFanoShape shape = ef_shape(entry.count, entry.lowBits, horizon);
+                const uint64_t base = entry.offset / 8;
+                const uint64_t i = rank[keys[k]]++;
+                const uint32_t l = entry.lowBits;
+                if (l) {
+                    uint64_t v = adv & ((uint64_t(1) << l) - 1);
+                    uint64_t bit = i * l;
+                    uint32_t off = (uint32_t)(bit & 63);
+                    index_or(words, base + (bit >> 6), v << off);
+                    if (off + l > 64) index_or(words, base + (bit >> 6) + 1, v >> (64 - off));
+                }
+                uint64_t highPos = (adv >> l) + i;
+                index_or(words, base + shape.lowWords + (highPos >> 6), uint64_t(1) << (highPos & 63));
+                if (i % EF_SKIP == 0) words[base + shape.lowWords + shape.highWords + i / EF_SKIP] = highPos;
+            }
+        });
+    });
+
+    for (AdvanceIndexList &entry : dir) {
+        entry.checksum = index_checksum(words + entry.offset / 8, ef_shape(entry.count, entry.lowBits, horizon).words());
+    }
+    AdvanceIndexHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.backend = (backend == RngBackend::PS2) ? 0u : 1u;
+    header.baseSeed = baseSeed;
+    header.listCount = INDEX_LIST_COUNT;
+    header.horizon = horizon;
+    header.checksum = index_checksum(reinterpret_cast<const uint64_t *>(dir.data()),
+                                     sizeof(AdvanceIndexList) * INDEX_LIST_COUNT / 8);
+    std::memcpy(words, &header, sizeof(header));
+    std::memcpy(reinterpret_cast<uint8_t *>(words) + sizeof(header), dir.data(),
+                sizeof(AdvanceIndexList) * INDEX_LIST_COUNT);
+
+    if (!output.finish(path)) {
+        std::cout << "Failed writing " << path << "\n";
+        return false;
+    }
+    std::cout << "Wrote " << path << " (" << offset << " bytes).\n";
+    return true;
+}
+
+static constexpr uint64_t PS2_MOD = 0x80000000ull;
+
+// One PS2 step back, with the 2^31 modulus applied by masking.
+static inline uint32_t ps2_prev_seed(uint32_t cur) {
+    return (PS2_RETREAT.mul * cur + PS2_RETREAT.add) & 0x7FFFFFFFu;
+}
+
+// Paging position of find_clock_base_seeds: how many minute-draw states
+// have been examined. A default cursor starts at the first state; `done`
+// is set once every state has been.
+struct ClockSeedCursor {
+    uint64_t step = 0;
+    bool done = false;
+};
+
+// Base seeds whose clock puzzle after warmupAfterReset advances shows
+// targetHour:targetMinute, in order of their minute-draw state, at most
+// maxResults per call; pass a cursor to page on from the previous call.
+// On PS2 the hour and minute draws are consecutive states s1 and s2 with
+// s2 = minute (mod 60) and s1 = rem (mod 12). The advance map is 1 (mod 4)
+// in both terms, so s1 = s2 - 1 (mod 4): the power-of-two parts either
+// always agree or never do, and only s1 (mod 3) is left to sieve. Walking
+// s2 in steps of 60 moves s1 by a fixed stride, so each candidate costs an
+// add and roughly every third one is a result.
+std::vector<uint32_t> find_clock_base_seeds(int targetHour, int targetMinute, uint8_t modeByte,
+                                           int64_t warmupAfterReset, int maxResults = 200,
+                                           ClockSeedCursor *cursor = nullptr) {
+    std::vector<uint32_t> out;
+    ClockSeedCursor local;
+    ClockSeedCursor &at = cursor ? *cursor : local;
+    if (at.done || warmupAfterReset < 0 || maxResults <= 0) return out;
+
+    const int rem = (modeByte == 2) ? targetHour - 12 : targetHour - 1;
+    const uint32_t minute = (uint32_t)(((targetMinute % 60) + 60) % 60);
+    if (rem < 0 || rem > 11 || (minute + 3) % 4 != (uint32_t)rem % 4) {
+        at.done = true;
+        return out;
+    }
+
+    // From the hour draw back past the warmup to the base seed.
+    const LcgAffine rewind = rng_rewind_jump(RngBackend::PS2, (uint64_t)warmupAfterReset + 1);
+    const uint64_t steps = (PS2_MOD - minute + 59) / 60;
+    const uint32_t stride = PS2_RETREAT.mul * 60u;
+    uint32_t seed1 = ps2_prev_seed(minute + 60u * (uint32_t)std::min(at.step, steps));
+    for (; at.step < steps && (int)out.size() < maxResults; ++at.step, seed1 = (seed1 + stride) & 0x7FFFFFFFu) {
+        if (seed1 % 3 != (uint32_t)rem % 3) continue;
+        out.push_back(rng_apply(rewind, seed1, RngBackend::PS2));
+    }
+    if (at.step >= steps) at.done = true;
+    return out;
+}
+
+// PC state recovery. A rand15 draw shows bits 16-30 of the state it
+// leaves behind, so the first observed draw fixes 15 of the 32 bits and the
+// other 17 (bits 0-15 and 31) are tried exhaustively; every later observed
+// draw is a check on the states that follow. A rand31 return is three such
+// draws: two whole ones and the low bit of the third. Carries only move
+// upward, so bit 31 never reaches a later draw either: states come in
+// pairs that differ only there, and both are reported.
+struct PcDrawConstraint {
+    uint32_t mask;    // bits of the 15-bit draw that were observed
+    uint32_t value;
+};
+
+struct PcRecoveredState {
+    uint32_t myseed;            // state before the first observed draw
+    uint64_t advancesFromZero;  // rand31 calls from seed 0 to myseed
+    uint64_t stepsFromZero;     // the same distance in rand15 calls
+};
+
+static constexpr LcgAffine PC_STEP_BACK = lcg_inverse(PC_STEP);
+static constexpr uint32_t PC_HIDDEN_CANDIDATES = 1u << 17;
+static constexpr uint32_t PC_RECOVERY_BLOCK = 1u << 12;
+
+// Checks for consecutive observed values, each a rand31 return or, with
+// `rand15`, a single rand15 draw; empty if a value is out of range.
+static std::vector<PcDrawConstraint> pc_draw_constraints(const std::vector<uint32_t> &observed, bool rand15) {
+    std::vector<PcDrawConstraint> out;
+    for (uint32_t v : observed) {
+        if (v > (rand15 ? 0x7FFFu : 0x7FFFFFFFu)) return {};
+        if (rand15) {
+            out.push_back({0x7FFFu, v});
+        } else {
+            out.push_back({0x7FFFu, v & 0x7FFFu});
+            out.push_back({0x7FFFu, (v >> 15) & 0x7FFFu});
+            out.push_back({1u, v >> 30});
+        }
+    }
+    return out;
+}
+
+// Bitmask of the SIMD_LANES hidden-bit candidates from `first` on whose
+// states pass every check. Lane j starts from the state after the first
+// draw, with bit 31 and bits 0-15 taken from first + j.
+SH3_SIMD_KERNEL static uint32_t pc_recover_lanes(uint32_t first, const PcDrawConstraint *SH3_RESTRICT checks,
+                                                 size_t count) {
+    uint32_t st[SIMD_LANES];
+    uint32_t ok[SIMD_LANES];
+    for (int j = 0; j < SIMD_LANES; ++j) {
+        const uint32_t hidden = first + (uint32_t)j;
+        st[j] = ((hidden >> 16) << 31) | (checks[0].value << 16) | (hidden & 0xFFFFu);
+        ok[j] = 1u;
+    }
+    for (size_t k = 1; k < count; ++k) {
+        const uint32_t mask = checks[k].mask;
+        const uint32_t value = checks[k].value;
+        uint32_t any = 0;
+        for (int j = 0; j < SIMD_LANES; ++j) {
+            st[j] = st[j] * PC_STEP.mul + PC_STEP.add;
+            ok[j] &= (uint32_t)(((st[j] >> 16) & mask) == value);
+            any |= ok[j];
+        }
+        if (!any) return 0;
+    }
+    uint32_t bits = 0;
+    for (int j = 0; j < SIMD_LANES; ++j) bits |= ok[j] << j;
+    return bits;
+}
+
+// Every PC state consistent with the observed draws, nearest to seed 0
+// first. Blocks of the 2^17 hidden-bit candidates are shared out to the
+// scan threads.
+static std::vector<PcRecoveredState> recover_pc_states(const std::vector<PcDrawConstraint> &checks) {
+    std::vector<PcRecoveredState> out;
+    if (checks.empty() || checks[0].mask != 0x7FFFu) return out;
+
+    const uint32_t blocks = PC_HIDDEN_CANDIDATES / PC_RECOVERY_BLOCK;
+    std::atomic<uint32_t> nextBlock{0};
+    std::mutex outMutex;
+    std::vector<uint32_t> states;
+    auto worker = [&]() {
+        for (;;) {
+            const uint32_t block = nextBlock.fetch_add(1, std::memory_order_relaxed);
+            if (block >= blocks) return;
+            std::vector<uint32_t> found;
+            const uint32_t end = (block + 1) * PC_RECOVERY_BLOCK;
+            for (uint32_t first = block * PC_RECOVERY_BLOCK; first < end; first += SIMD_LANES) {
+                for (uint32_t bits = pc_recover_lanes(first, checks.data(), checks.size()); bits; bits &= bits - 1) {
+                    const uint32_t hidden = first + (uint32_t)__builtin_ctz(bits);
+                    found.push_back(((hidden >> 16) << 31) | (checks[0].value << 16) | (hidden & 0xFFFFu));
+                }
+            }
+            if (found.empty()) continue;
+            std::lock_guard<std::mutex> lock(outMutex);
+            states.insert(states.end(), found.begin(), found.end());
+        }
+    };
+
+    const unsigned threads = std::min(scan_thread_count(), blocks);
+    if (threads == 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        pool.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+        for (auto &th : pool) th.join();
+    }
+
+    for (uint32_t state : states) {
+        PcRecoveredState r;
+        r.myseed = rng_apply(PC_STEP_BACK, state, RngBackend::PC);
+        r.advancesFromZero = *find_seed_distance(0, r.myseed, RngBackend::PC);
+        // One advance is three rand15 steps, and the step map alone also
+        // has period 2^32.
+        r.stepsFromZero = (3u * r.advancesFromZero) & 0xFFFFFFFFu;
+        out.push_back(r);
+    }
+    std::sort(out.begin(), out.end(), [](const PcRecoveredState &a, const PcRecoveredState &b) {
+        return a.advancesFromZero < b.advancesFromZero;
+    });
+    return out;
+}
+
+// Both are solved exactly over the whole period. On PS2 the rand() return
+// is the state itself; on PC the states that can produce it are recovered
+// and the nearest one ahead of baseSeed wins.
+std::optional<uint64_t> find_warmup_for_first(uint32_t baseSeed, uint32_t R_first, RngBackend backend) {
+    if (backend == RngBackend::PS2) {
+        auto dist = find_seed_distance(baseSeed, R_first, backend);
+        if (!dist) return std::nullopt;
+        if (*dist == 0) return rng_period(backend) - 1;
+        return *dist - 1;
+    }
+
+    std::optional<uint64_t> best;
+    for (const PcRecoveredState &r : recover_pc_states(pc_draw_constraints({R_first}, false))) {
+        uint64_t dist = *find_seed_distance(baseSeed, r.myseed, backend);
+        if (!best || dist < *best) best = dist;
+    }
+    return best;
+}
+
+uint32_t gen_shakespeare_code(uint32_t seed, int64_t warmupAfterReset, RngBackend backend, bool verbose=false) {
+    rng_advance(seed, backend, (uint64_t)std::max<int64_t>(warmupAfterReset, 0));
+
+    uint32_t r[4];
+    uint32_t tuple = 0;
+    for (int i = 0; i < 4; ++i) {
+        r[i] = rng_next31(seed, backend);
+        uint32_t size = 10u - (uint32_t)i;
+        tuple = tuple * size + r[i] % size;
+    }
+    uint32_t code4 = SHAKESPEARE_CODES[tuple];
+
+    if (verbose) {
+        for (int i = 0; i < 4; ++i) {
+            int size = 10 - i;
+            std::cout << "rand#" << (i + 1)
+                      << " = 0x" << std::hex << std::uppercase << r[i]
+                      << std::dec
+                      << ", size=" << size
+                      << ", idx=" << (r[i] % (uint32_t)size)
+                      << ", digit=" << ((code4 >> (12 - 4 * i)) & 0xF) << "\n";
+        }
+    }
+
+    return code4;
+}
+
+uint32_t gen_clock_puzzle(uint32_t seed, int64_t warmupAfterReset, uint8_t modeByte, RngBackend backend, bool verbose=false) {
+    rng_advance(seed, backend, (uint64_t)std::max<int64_t>(warmupAfterReset, 0));
+
+    uint32_t rHour = rng_next31(seed, backend);
+    int hour;
+    if (modeByte == 2) {
+        hour = static_cast<int>(rHour % 12) + 12;
+    } else {
+        hour = static_cast<int>(rHour % 12) + 1;
+    }
+
+    int h_tens = hour / 10;
+    int h_ones = hour % 10;
+
+    uint32_t packed = (static_cast<uint32_t>(h_tens) << 12) |
+                      (static_cast<uint32_t>(h_ones) << 8);
+
+    if (verbose) {
+        std::cout << "Hour RNG  = 0x" << std::hex << std::uppercase << rHour << std::dec
+                  << " -> hour=" << hour
+                  << " (tens=" << h_tens << ", ones=" << h_ones << ")\n";
+    }
+
+    uint32_t rMin = rng_next31(seed, backend);
+    int minute = static_cast<int>(rMin % 60);
+
+    int m_tens = minute / 10;
+    int m_ones = minute % 10;
+
+    packed |= (static_cast<uint32_t>(m_tens) << 4) |
+              (static_cast<uint32_t>(m_ones));
+
+    if (verbose) {
+        std::cout << "Min RNG   = 0x" << std::hex << std::uppercase << rMin << std::dec
+                  << " -> minute=" << minute
+                  << " (tens=" << m_tens << ", ones=" << m_ones << ")\n";
+    }
+
+    return packed;
+}
+
+struct ClockWarmupMatch {
+    int64_t warmup;
+    uint32_t seedAfterWarmup;
+    uint32_t rHour;
+    uint32_t rMin;
+    uint32_t packed;
+};
+
+// Hour remainder rHour % 12 that gives targetHour, or 12 (never drawn) if none does.
+static int clock_hour_rem(int targetHour, uint8_t modeByte) {
+    int rem = targetHour - ((modeByte == 2) ? 12 : 1);
+    return (rem < 0 || rem > 11) ? 12 : rem;
+}
+
+static ClockWarmupMatch make_clock_match(int64_t w, uint32_t seedAfterWarmup, uint8_t modeByte,
+                                         RngBackend backend, bool matchHour, bool matchMinute) {
+    uint32_t seed = seedAfterWarmup;
+    uint32_t rHour = 0;
+    uint32_t rMin  = 0;
+    int hour = 0;
+    int minute = 0;
+
+    if (matchHour && !matchMinute) {
+        rHour = rng_next31(seed, backend);
+        hour = (modeByte == 2) ? (int)(rHour % 12) + 12
+                               : (int)(rHour % 12) + 1;
+    } else if (!matchHour && matchMinute) {
+        rMin = rng_next31(seed, backend);
+        minute = (int)(rMin % 60);
+    } else {
+        rHour = rng_next31(seed, backend);
+        hour = (modeByte == 2) ? (int)(rHour % 12) + 12
+                               : (int)(rHour % 12) + 1;
+        rMin = rng_next31(seed, backend);
+        minute = (int)(rMin % 60);
+    }
+
+    int h_tens = hour / 10, h_ones = hour % 10;
+    int m_tens = minute / 10, m_ones = minute % 10;
+    uint32_t packed = ((uint32_t)h_tens << 12) | ((uint32_t)h_ones << 8) |
+                      ((uint32_t)m_tens << 4) | (uint32_t)m_ones;
+
+    return {w, seedAfterWarmup, rHour, rMin, packed};
+}
+
+static ResiduePredicate compile_clock_warmups_predicate(uint8_t modeByte, int targetHour, int targetMinute) {
+    const int minute = (targetMinute >= 0 && targetMinute < 60) ? targetMinute : 60;
+    return compile_clock_predicate(clock_hour_rem(targetHour, modeByte), minute, false);
+}
+
+// With neither flag set every advance matches.
+static ResiduePredicate compile_clock_flexible_predicate(uint8_t modeByte, bool matchHour, bool matchMinute,
+                                                         int targetHour, int targetMinute) {
+    const int hourRem = matchHour ? clock_hour_rem(targetHour, modeByte) : -1;
+    const int minute = !matchMinute ? -1 : (targetMinute >= 0 && targetMinute < 60) ? targetMinute : 60;
+    return compile_clock_predicate(hourRem, minute, matchMinute && !matchHour);
+}
+
+std::vector<ClockWarmupMatch> find_clock_warmups(uint32_t baseSeed, uint8_t modeByte,
+                                               int targetHour, int targetMinute,
+                                               RngBackend backend,
+                                               int64_t minWarmup = 0, int64_t maxWarmup = 5000, int maxResults = 50) {
+    const ResiduePredicate pred = compile_clock_warmups_predicate(modeByte, targetHour, targetMinute);
+    if (pred.empty()) return {};
+
+    return scan_sharded<ClockWarmupMatch>(baseSeed, backend, minWarmup, maxWarmup, maxResults,
+        [&](const ScanShard &shard, std::vector<ClockWarmupMatch> &matches) {
+            scan_shard_predicate(shard, backend, pred, maxResults, matches,
+                [&](int64_t w, uint32_t seedAfterWarmup, std::vector<ClockWarmupMatch> &o) {
+                    o.push_back(make_clock_match(w, seedAfterWarmup, modeByte, backend, true, true));
+                });
+        });
+}
+
+std::vector<ClockWarmupMatch> find_clock_warmups_flexible(uint32_t baseSeed, uint8_t modeByte,
+                                                       RngBackend backend,
+                                                       bool matchHour, bool matchMinute,
+                                                       int targetHour, int targetMinute,
+                                                       int64_t minWarmup = 0, int64_t maxWarmup = 5000, int maxResults = 50) {
+    const ResiduePredicate pred = compile_clock_flexible_predicate(modeByte, matchHour, matchMinute,
+                                                                   targetHour, targetMinute);
+    if (pred.empty()) return {};
+
+    return scan_sharded<ClockWarmupMatch>(baseSeed, backend, minWarmup, maxWarmup, maxResults,
+        [&](const ScanShard &shard, std::vector<ClockWarmupMatch> &matches) {
+            scan_shard_predicate(shard, backend, pred, maxResults, matches,
+                [&](int64_t w, uint32_t seedAfterWarmup, std::vector<ClockWarmupMatch> &o) {
+                    o.push_back(make_clock_match(w, seedAfterWarmup, modeByte, backend, matchHour, matchMinute));
+                });
+        });
+}
+
+static std::optional<uint32_t> parse_shakespeare_code_input(const std::string& s) {
+    std::string t;
+    t.reserve(s.size());
+    for (char ch : s) {
+        if (!std::isspace((unsigned char)ch)) t.push_back(ch);
+    }
+    if (t.empty()) return std::nullopt;
+
+    bool looksHex = false;
+    if (t.size() >= 2 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X')) looksHex = true;
+    for (char ch : t) {
+        if ((ch >= 'A' && ch <= 'F') || (ch >= 'a' && ch <= 'f')) {
+            looksHex = true;
+            break;
+        }
+    }
+
+    uint32_t packed = 0;
+
+    if (looksHex) {
+        size_t idx = 0;
+        if (t.size() >= 2 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X')) idx = 2;
+        if (t.size() - idx == 0 || t.size() - idx > 8) return std::nullopt;
+
+        uint32_t val = 0;
+        for (; idx < t.size(); ++idx) {
+            char ch = t[idx];
+            int v = -1;
+            if (ch >= '0' && ch <= '9') v = ch - '0';
+            else if (ch >= 'A' && ch <= 'F') v = 10 + (ch - 'A');
+            else if (ch >= 'a' && ch <= 'f') v = 10 + (ch - 'a');
+            else return std::nullopt;
+            val = (val << 4) | (uint32_t)v;
+        }
+        packed = val;
+    } else {
+        if (t.size() != 4) return std::nullopt;
+        packed = 0;
+        for (char ch : t) {
+            if (ch < '0' || ch > '9') return std::nullopt;
+            packed = (packed << 4) | (uint32_t)(ch - '0');
+        }
+    }
+
+    bool used[10] = {false};
+    for (int i = 0; i < 4; ++i) {
+        int digit = (packed >> (12 - 4 * i)) & 0xF;
+        if (digit < 0 || digit > 9) return std::nullopt;
+        if (used[digit]) return std::nullopt;
+        used[digit] = true;
+    }
+
+    return packed;
+}
+
+struct ShakespeareMatch {
+    int64_t advances;
+    uint32_t seedAfterWarmup;
+    uint32_t codePacked;
+};
+
+static inline uint32_t gen_shakespeare_code_from_seed(uint32_t seedAfterWarmup, RngBackend backend) {
+    return SHAKESPEARE_CODES[draw_tuple<10>(seedAfterWarmup, backend)];
+}
+
+static std::vector<ShakespeareMatch> find_shakespeare_seeds_for_code(
+    uint32_t startSeed,
+    uint32_t targetCodePacked,
+    int maxResults,
+    RngBackend backend,
+    int64_t minAdvances = 0,
+    int64_t hardMaxAdvances = 10'000'000
+) {
+    const ResiduePredicate pred = compile_code_predicate(targetCodePacked, 0, 10);
+    if (pred.empty()) return {};
+
+    auto emit = [&](int64_t adv, uint32_t seedWarm, std::vector<ShakespeareMatch> &o) {
+        o.push_back({adv, seedWarm, targetCodePacked});
+    };
+    return find_indexed<ShakespeareMatch>(IndexPuzzle::Shakespeare, encode_draw_tuple(targetCodePacked, 0, 10),
+        startSeed, backend, minAdvances, hardMaxAdvances, maxResults, emit,
+        [&](int64_t first, int64_t last, int quota) {
+            return scan_sharded<ShakespeareMatch>(startSeed, backend, first, last, quota,
+                [&](const ScanShard &shard, std::vector<ShakespeareMatch> &out) {
+                    scan_shard_predicate(shard, backend, pred, quota, out, emit);
+                });
+        });
+}
+
+static void print_shakespeare(uint32_t code) {
+    std::cout << "\nShakespeare 4-digit code = 0x"
+              << std::hex << std::uppercase << code << std::dec
+              << " (digits packed as nibbles)\n";
+    std::cout << "Digits shown as decimal: "
+              << ((code >> 12) & 0xF)
+              << ((code >> 8)  & 0xF)
+              << ((code >> 4)  & 0xF)
+              << (code & 0xF) << "\n";
+}
+
+static void print_clock(uint32_t packed) {
+    int h_tens = (packed >> 12) & 0xF;
+    int h_ones = (packed >> 8)  & 0xF;
+    int m_tens = (packed >> 4)  & 0xF;
+    int m_ones = (packed)       & 0xF;
+
+    int hour = h_tens * 10 + h_ones;
+    int minute = m_tens * 10 + m_ones;
+
+    std::cout << "\nClock puzzle packed = 0x"
+              << std::hex << std::uppercase << packed << std::dec << "\n";
+    std::cout << "Decoded time = "
+              << hour << ":"
+              << (minute < 10 ? "0" : "") << minute << "\n";
+    std::cout << "Digits: " << h_tens << h_ones << m_tens << m_ones << "\n";
+}
+
+struct HospitalMatch {
+    int64_t advances;
+    uint32_t seedAfterWarmup;
+    uint32_t codePacked;
+};
+
+uint32_t gen_hospital3f_code(uint32_t seed, int64_t warmupAfterReset, RngBackend backend, bool verbose=false);
+static void print_hospital3f(uint32_t code);
+static std::optional<uint32_t> parse_hospital3f_code_input(const std::string& s);
+static inline uint32_t gen_hospital3f_code_from_seed(uint32_t seedAfterWarmup, RngBackend backend);
+
+static std::vector<HospitalMatch> find_hospital3f_seeds_for_code(
+    uint32_t startSeed,
+    uint32_t targetCodePacked,
+    int maxResults,
+    RngBackend backend,
+    int64_t minAdvances,
+    int64_t maxAdvances
+);
+
+struct CrematoriumMatch {
+    int64_t advances;
+    uint32_t seedAfterWarmup;
+    uint32_t codePacked;
+    bool forced7;
+    int forcedPosLSB; 
+};
+
+struct CrematoriumMeta {
+    uint32_t codePacked;
+    bool forced7;
+    int forcedPosLSB; 
+};
+
+uint32_t gen_crematorium_code_guarantee7(uint32_t seed, int64_t warmupAfterReset, RngBackend backend, bool verbose=false);
+static inline CrematoriumMeta gen_crematorium_meta_from_seed(uint32_t seedAfterWarmup, RngBackend backend);
+static void print_crematorium(uint32_t code, bool forced7, int forcedPosLSB);
+static std::optional<uint32_t> parse_crematorium_code_input(const std::string& s);
+
+static std::vector<CrematoriumMatch> find_crematorium_seeds_for_code(
+    uint32_t startSeed,
+    uint32_t targetCodePacked,
+    int maxResults,
+    RngBackend backend,
+    int64_t minAdvances,
+    int64_t maxAdvances
+);
+
+// Multi-target reverse search: every code of a CodeSet answered in one
+// pass. Codes come in groups (one per listed code, or every code a pattern
+// like 7?2? or [13]???+5 fits), each with its own quota of earliest
+// matches; the search ends once every group has its quota or the range
+// runs out.
+struct CodeSetMatch {
+    int64_t advances;
+    uint32_t seedAfterWarmup;
+    uint32_t codePacked;
+    bool forced7;
+    int forcedPosLSB;
+};
+
+// Bit of `code` in a CodeSet, or DRAW_TUPLE_NONE if the puzzle cannot show it.
+static uint32_t code_set_key(IndexPuzzle puzzle, uint32_t code) {
+    if (puzzle == IndexPuzzle::Hospital3F) return encode_draw_tuple(code, 1, 9);
+    return encode_draw_tuple(code, 0, 10);
+}
+
+static ResiduePredicate compile_code_set_predicate(IndexPuzzle puzzle, const CodeSet &targets) {
+    switch (puzzle) {
+        case IndexPuzzle::Shakespeare: return compile_code_set_predicate(targets, 10);
+        case IndexPuzzle::Hospital3F:  return compile_code_set_predicate(targets, 9);
+        case IndexPuzzle::Crematorium: break;
+    }
+    return compile_crematorium_set_predicate(targets);
+}
+
+static CodeSetMatch decode_code_set_match(IndexPuzzle puzzle, int64_t adv, uint32_t seed, RngBackend backend) {
+    uint32_t s = seed;
+    switch (puzzle) {
+        case IndexPuzzle::Shakespeare: return {adv, seed, SHAKESPEARE_CODES[draw_tuple<10>(s, backend)], false, -1};
+        case IndexPuzzle::Hospital3F:  return {adv, seed, HOSPITAL3F_CODES[draw_tuple<9>(s, backend)], false, -1};
+        case IndexPuzzle::Crematorium: break;
+    }
+    CrematoriumMeta meta = gen_crematorium_meta_from_seed(seed, backend);
+    return {adv, seed, meta.codePacked, meta.forced7, meta.forcedPosLSB};
+}
+
+struct CodeSetGroup {
+    CodeSet codes;
+    int quota;
+};
+
+// Match counts of a code-set search. A match is kept while some group
+// holding its code is short of its quota, and counts toward every such
+// group; `open` holds the codes those groups still want.
+struct CodeSetQuotas {
+    const std::vector<CodeSetGroup> *groups;
+    std::vector<int> taken;
+    CodeSet open;
+
+    explicit CodeSetQuotas(const std::vector<CodeSetGroup> &g) : groups(&g), taken(g.size(), 0) {
+        update_open();
+    }
+
+    void update_open() {
+        open.reset();
+        for (size_t i = 0; i < groups->size(); ++i) {
+            if (taken[i] < (*groups)[i].quota) open |= (*groups)[i].codes;
+        }
+    }
+
+    bool take(uint32_t key) {
+        if (!open[key]) return false;
+        bool closed = false;
+        for (size_t i = 0; i < groups->size(); ++i) {
+            const CodeSetGroup &group = (*groups)[i];
+            if (group.codes[key] && taken[i] < group.quota) closed |= (++taken[i] == group.quota);
+        }
+        if (closed) update_open();
+        return true;
+    }
+
+    // What each group still needs.
+    std::vector<CodeSetGroup> remaining() const {
+        std::vector<CodeSetGroup> left;
+        for (size_t i = 0; i < groups->size(); ++i) {
+            if (taken[i] < (*groups)[i].quota) left.push_back({(*groups)[i].codes, (*groups)[i].quota - taken[i]});
+        }
+        return left;
+    }
+};
+
+// Scans run over chunks that start at this size and double up to the cap,
+// so quotas met early end the search early.
+static constexpr int64_t CODE_SET_FIRST_CHUNK = int64_t(1) << 22;
+static constexpr int64_t CODE_SET_MAX_CHUNK = int64_t(1) << 28;
+
+// Earliest matches of every group in `groups` over [minAdvances,
+// maxAdvances], in advance order. Advances an advance index covers are
+// read from the codes' posting lists; only codes of groups still short of
+// their quota are scanned for past its horizon.
+static std::vector<CodeSetMatch> find_code_set_matches(IndexPuzzle puzzle, const std::vector<CodeSetGroup> &groups,
+                                                       uint32_t startSeed, RngBackend backend,
+                                                       int64_t minAdvances, int64_t maxAdvances) {
+    minAdvances = std::max<int64_t>(minAdvances, 0);
+    CodeSetQuotas counts(groups);
+    if (counts.open.none() || maxAdvances < minAdvances) return {};
+
+    std::vector<CodeSetMatch> out;
+    auto take = [&](const CodeSetMatch &m) {
+        if (counts.take(code_set_key(puzzle, m.codePacked))) out.push_back(m);
+    };
+
+    int64_t scanFrom = minAdvances;
+    const AdvanceIndex *index = advance_index(backend);
+    if (index && index->header.baseSeed == startSeed && minAdvances < (int64_t)index->header.horizon) {
+        const int64_t horizonLast = (int64_t)index->header.horizon - 1;
+        bool listFailed = false;
+        std::vector<CodeSetMatch> indexed;
+        auto emit = [&](int64_t adv, uint32_t seed, std::vector<CodeSetMatch> &o) {
+            o.push_back(decode_code_set_match(puzzle, adv, seed, backend));
+        };
+        for (size_t key = 0; key < counts.open.size() && !listFailed; ++key) {
+            if (!counts.open[key]) continue;
+            int cap = 0;
+            for (const CodeSetGroup &group : groups) {
+                if (group.codes[key]) cap = std::max(cap, group.quota);
+            }
+            std::vector<CodeSetMatch> hits = find_indexed<CodeSetMatch>(puzzle, (uint32_t)key, startSeed, backend,
+                minAdvances, std::min(maxAdvances, horizonLast), cap, emit,
+                [&](int64_t, int64_t, int) {
+                    listFailed = true;
+                    return std::vector<CodeSetMatch>{};
+                });
+            indexed.insert(indexed.end(), hits.begin(), hits.end());
+        }
+        if (!listFailed) {
+            std::sort(indexed.begin(), indexed.end(),
+                      [](const CodeSetMatch &a, const CodeSetMatch &b) { return a.advances < b.advances; });
+            for (const CodeSetMatch &m : indexed) take(m);
+            scanFrom = std::max(minAdvances, horizonLast + 1);
+        }
+    }
+
+    int64_t chunkSize = CODE_SET_FIRST_CHUNK;
+    for (int64_t chunk = scanFrom, chunkLast; chunk <= maxAdvances && counts.open.any(); chunk = chunkLast + 1) {
+        chunkLast = std::min(maxAdvances, chunk + chunkSize - 1);
+        const ResiduePredicate pred = compile_code_set_predicate(puzzle, counts.open);
+        // A shard counts against what each group still needs, keeping every
+        // match the merged result could; each kept match fills some group,
+        // so reaching the sum of those needs means the shard is satisfied.
+        const std::vector<CodeSetGroup> left = counts.remaining();
+        int64_t needed = 0;
+        for (const CodeSetGroup &group : left) needed += group.quota;
+        const int cap = (int)std::min<int64_t>(needed, INT32_MAX);
+        // A lone group counts every match, so the plain quota applies; else
+        // the merged shards replay the counts and higher shards stop once
+        // every group is satisfied.
+        const int quota = (left.size() == 1) ? cap : INT32_MAX;
+        CodeSetQuotas prefixCounts = counts;
+        auto prefixDone = [&](const std::vector<CodeSetMatch> &shardMatches) {
+            for (const CodeSetMatch &m : shardMatches) prefixCounts.take(code_set_key(puzzle, m.codePacked));
+            return prefixCounts.open.none();
+        };
+        std::vector<CodeSetMatch> found = scan_sharded<CodeSetMatch>(startSeed, backend, chunk, chunkLast, quota,
+            [&](const ScanShard &shard, std::vector<CodeSetMatch> &shardOut) {
+                CodeSetQuotas shardCounts(left);
+                scan_shard_predicate(shard, backend, pred, cap, shardOut,
+                    [&](int64_t adv, uint32_t seed, std::vector<CodeSetMatch> &o) {
+                        CodeSetMatch m = decode_code_set_match(puzzle, adv, seed, backend);
+                        if (shardCounts.take(code_set_key(puzzle, m.codePacked))) o.push_back(m);
+                    });
+            },
+            prefixDone);
+        for (const CodeSetMatch &m : found) take(m);
+        chunkSize = std::min(chunkSize * 2, CODE_SET_MAX_CHUNK);
+    }
+    return out;
+}
+
+// A partial code: the digits each position allows (bit d for digit d),
+// and digits the code must contain somewhere.
+struct CodePattern {
+    uint16_t allowed[4];
+    uint16_t required;
+};
+
+static bool is_code_pattern(const std::string &s) {
+    return s.find_first_of("?[+") != std::string::npos;
+}
+
+// "7?2?", "[13]???", "[^7][0-4]??+5": per position a digit, ? for any, or a
+// bracketed set of digits and ranges (^ negates it); every "+d" after the
+// four positions requires digit d somewhere in the code.
+static std::optional<CodePattern> parse_code_pattern(const std::string &s) {
+    CodePattern pattern{};
+    size_t i = 0;
+    for (int pos = 0; pos < 4; ++pos) {
+        if (i >= s.size()) return std::nullopt;
+        char ch = s[i++];
+        if (ch == '?') {
+            pattern.allowed[pos] = 0x3FF;
+        } else if (ch >= '0' && ch <= '9') {
+            pattern.allowed[pos] = (uint16_t)(1u << (ch - '0'));
+        } else if (ch == '[') {
+            const bool negate = i < s.size() && s[i] == '^';
+            if (negate) ++i;
+            uint16_t digits = 0;
+            while (i < s.size() && s[i] != ']') {
+                if (s[i] < '0' || s[i] > '9') return std::nullopt;
+                int lo = s[i++] - '0', hi = lo;
+                if (i + 1 < s.size() && s[i] == '-' && s[i + 1] >= '0' && s[i + 1] <= '9') {
+                    hi = s[i + 1] - '0';
+                    i += 2;
+                }
+                for (int d = lo; d <= hi; ++d) digits |= (uint16_t)(1u << d);
+            }
+            if (i >= s.size()) return std::nullopt;
+            ++i;
+            pattern.allowed[pos] = negate ? (uint16_t)(~digits & 0x3FF) : digits;
+        } else {
+            return std::nullopt;
+        }
+    }
+    while (i < s.size()) {
+        if (s[i] != '+' || i + 1 >= s.size() || s[i + 1] < '0' || s[i + 1] > '9') return std::nullopt;
+        pattern.required |= (uint16_t)(1u << (s[i + 1] - '0'));
+        i += 2;
+    }
+    return pattern;
+}
+
+// Adds every code the puzzle can show that fits `pattern` to `set`; the
+// CodeSet key of a code is its own draw tuple, so the tables are walked
+// directly. Returns how many codes fit.
+static size_t add_code_pattern(IndexPuzzle puzzle, const CodePattern &pattern, CodeSet &set) {
+    const bool hospital = (puzzle == IndexPuzzle::Hospital3F);
+    const size_t tuples = hospital ? HOSPITAL3F_TUPLES : SHAKESPEARE_TUPLES;
+    size_t added = 0;
+    for (size_t tuple = 0; tuple < tuples; ++tuple) {
+        const uint32_t code = hospital ? HOSPITAL3F_CODES[tuple] : SHAKESPEARE_CODES[tuple];
+        uint16_t seen = 0;
+        bool fits = true;
+        for (int pos = 0; pos < 4; ++pos) {
+            const uint32_t digit = (code >> (12 - 4 * pos)) & 0xF;
+            fits &= (pattern.allowed[pos] >> digit) & 1u;
+            seen |= (uint16_t)(1u << digit);
+        }
+        // Every crematorium code ends up with a 7.
+        const uint16_t required = pattern.required | (puzzle == IndexPuzzle::Crematorium ? (1u << 7) : 0u);
+        if (!fits || (seen & required) != required) continue;
+        set.set(tuple);
+        ++added;
+    }
+    return added;
+}
+
+// Splits "1234,5678,7?2? ..." into groups: one per code, parsed with
+// `parse`, and one per pattern. Quotas are left at 0. False if any item is
+// invalid or a pattern fits no code.
+template <typename ParseFn>
+static bool parse_code_list(const std::string &text, IndexPuzzle puzzle, ParseFn parse,
+                            std::vector<CodeSetGroup> &groups) {
+    std::string item;
+    std::istringstream in(text);
+    while (std::getline(in, item, ',')) {
+        CodeSetGroup group{};
+        if (is_code_pattern(item)) {
+            std::optional<CodePattern> pattern = parse_code_pattern(item);
+            if (!pattern || add_code_pattern(puzzle, *pattern, group.codes) == 0) return false;
+        } else {
+            std::optional<uint32_t> code = parse(item);
+            if (!code) return false;
+            uint32_t key = code_set_key(puzzle, *code);
+            if (key == DRAW_TUPLE_NONE) return false;
+            group.codes.set(key);
+        }
+        groups.push_back(group);
+    }
+    return !groups.empty();
+}
+
+static void print_code_set_matches(const std::vector<CodeSetMatch> &matches, uint32_t startSeed) {
+    std::cout << "\nMatches from seed 0x" << std::hex << std::uppercase << startSeed << std::dec
+              << " (each advance = 1 rand call):\n";
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const CodeSetMatch &m = matches[i];
+        std::cout << "  [" << i << "] advances=" << m.advances
+                  << "  seed@advance=0x" << std::hex << std::uppercase << m.seedAfterWarmup << std::dec
+                  << "  code=" << ((m.codePacked >> 12) & 0xF) << ((m.codePacked >> 8) & 0xF)
+                  << ((m.codePacked >> 4) & 0xF) << (m.codePacked & 0xF);
+        if (m.forced7) std::cout << "  forced7 pos(LSB)=" << m.forcedPosLSB;
+        std::cout << "\n";
+    }
+}
+
+// Route solver: an ordered chain of puzzles generated a known number of
+// advances apart. Each step has a target (or none) and, after the first,
+// an offset range from the previous step's advance. A base advance b
+// matches when some p_0 = b, p_1, ..., p_n-1 has every step's puzzle hit
+// its target at p_k with p_k - p_k-1 inside step k's range.
+enum class RoutePuzzle { Shakespeare, Hospital3F, Crematorium, Clock };
+
+struct RouteStep {
+    RoutePuzzle puzzle;
+    bool any;               // only the spacing matters
+    uint32_t target;        // packed code, or packed HHMM for the clock
+    uint8_t modeByte;       // clock only
+    int64_t offsetMin;      // advances after the previous step
+    int64_t offsetMax;
+};
+
+// An advance where a puzzle hit its target, and the state there.
+struct StreamHit {
+    int64_t adv;
+    uint32_t seed;
+};
+
+struct RouteMatch {
+    int64_t baseAdvance;
+    uint32_t seedAtBase;
+    std::vector<int64_t> positions;   // advance of each step
+};
+
+static ResiduePredicate compile_route_predicate(const RouteStep &step) {
+    if (step.any) return make_residue_predicate({});
+    switch (step.puzzle) {
+        case RoutePuzzle::Shakespeare: return compile_code_predicate(step.target, 0, 10);
+        case RoutePuzzle::Hospital3F:  return compile_code_predicate(step.target, 1, 9);
+        case RoutePuzzle::Crematorium: return compile_crematorium_predicate(step.target);
+        case RoutePuzzle::Clock: break;
+    }
+    int hour = (int)((step.target >> 12) & 0xF) * 10 + (int)((step.target >> 8) & 0xF);
+    int minute = (int)((step.target >> 4) & 0xF) * 10 + (int)(step.target & 0xF);
+    return compile_clock_predicate(clock_hour_rem(hour, step.modeByte), minute < 60 ? minute : 60, false);
+}
+
+// Fraction of advances the predicate accepts, for uniform draws.
+static double residue_predicate_density(const ResiduePredicate &pred, int k = 0, uint32_t prefix = 0) {
+    if (k == pred.draws) {
+        if (pred.forcedPosMask.empty() || CREMATORIUM_CODES[prefix].has7) return 1.0;
+        return __builtin_popcount(pred.forcedPosMask[prefix]) / 4.0;
+    }
+    double sum = 0.0;
+    for (uint64_t bits = pred.stageMasks[k][prefix]; bits; bits &= bits - 1) {
+        sum += residue_predicate_density(pred, k + 1, prefix * pred.moduli[k] + (uint32_t)__builtin_ctzll(bits));
+    }
+    return sum / pred.moduli[k];
+}
+
+// Advances in the union of [p + lo, p + hi] over sorted `from` where `pred`
+// accepts the window, in ascending order.
+static std::vector<int64_t> route_reach(uint32_t startSeed, RngBackend backend, const ResiduePredicate &pred,
+                                        const std::vector<int64_t> &from, int64_t lo, int64_t hi) {
+    std::vector<int64_t> out;
+    size_t i = 0;
+    while (i < from.size()) {
+        int64_t first = from[i] + lo;
+        int64_t last = from[i] + hi;
+        for (++i; i < from.size() && from[i] + lo <= last + 1; ++i) last = from[i] + hi;
+        if (last < 0) continue;
+        first = std::max<int64_t>(first, 0);
+
+        uint32_t seed = startSeed;
+        rng_advance(seed, backend, (uint64_t)first);
+        with_backend(backend, [&](auto policy) {
+            using Backend = decltype(policy);
+            uint32_t o[STREAM_WINDOW];
+            for (int k = 0; k < STREAM_WINDOW; ++k) o[k] = Backend::next31(seed);
+            for (int64_t q = first;; ++q) {
+                if (residue_predicate_accepts(pred, o)) out.push_back(q);
+                if (q == last) break;
+                for (int k = 0; k < STREAM_WINDOW - 1; ++k) o[k] = o[k + 1];
+                o[STREAM_WINDOW - 1] = Backend::next31(seed);
+            }
+        });
+    }
+    return out;
+}
+
+// First q in sorted `to` with q - p in [lo, hi], or -1.
+static int64_t route_link(const std::vector<int64_t> &to, int64_t p, int64_t lo, int64_t hi) {
+    auto it = std::lower_bound(to.begin(), to.end(), p + lo);
+    return (it != to.end() && *it <= p + hi) ? *it : -1;
+}
+
+// Every base advance whose chains pass through step `pivot` at advance p,
+// restricted to [baseFirst, baseLast], with one witness chain each.
+static void route_chains_through(uint32_t startSeed, RngBackend backend, const std::vector<RouteStep> &steps,
+                                 const std::vector<ResiduePredicate> &preds, size_t pivot, int64_t p,
+                                 int64_t baseFirst, int64_t baseLast, std::vector<RouteMatch> &out) {
+    const size_t n = steps.size();
+    // back[k]: advances of step k that lead on to p; fwd[k]: advances of
+    // step k reachable from p that lead on to a full chain.
+    std::vector<std::vector<int64_t>> back(pivot + 1), fwd(n);
+    back[pivot] = {p};
+    for (size_t k = pivot; k-- > 0;) {
+        back[k] = route_reach(startSeed, backend, preds[k], back[k + 1],
+                              -steps[k + 1].offsetMax, -steps[k + 1].offsetMin);
+        if (back[k].empty()) return;
+    }
+    while (!back[0].empty() && back[0].back() > baseLast) back[0].pop_back();
+    back[0].erase(back[0].begin(), std::lower_bound(back[0].begin(), back[0].end(), baseFirst));
+    if (back[0].empty()) return;
+
+    fwd[pivot] = {p};
+    for (size_t k = pivot + 1; k < n; ++k) {
+        fwd[k] = route_reach(startSeed, backend, preds[k], fwd[k - 1], steps[k].offsetMin, steps[k].offsetMax);
+        if (fwd[k].empty()) return;
+    }
+    for (size_t k = n - 1; k > pivot + 1; --k) {
+        std::vector<int64_t> kept;
+        for (int64_t q : fwd[k - 1]) {
+            if (route_link(fwd[k], q, steps[k].offsetMin, steps[k].offsetMax) >= 0) kept.push_back(q);
+        }
+        fwd[k - 1].swap(kept);
+    }
+
+    std::vector<int64_t> tail(n);
+    tail[pivot] = p;
+    for (size_t k = pivot + 1; k < n; ++k) {
+        tail[k] = route_link(fwd[k], tail[k - 1], steps[k].offsetMin, steps[k].offsetMax);
+    }
+    for (int64_t base : back[0]) {
+        RouteMatch m{base, startSeed, tail};
+        m.positions[0] = base;
+        for (size_t k = 1; k < pivot; ++k) {
+            m.positions[k] = route_link(back[k], m.positions[k - 1], steps[k].offsetMin, steps[k].offsetMax);
+        }
+        rng_advance(m.seedAtBase, backend, (uint64_t)base);
+        out.push_back(std::move(m));
+    }
+}
+
+// Base advances in [minBase, maxBase] from startSeed where the whole route
+// is satisfied. Shards split the base range; inside a shard only the
+// advances where the most selective step hits are scanned for (with the
+// usual lane kernels and PS2 sieve), and the rest of the chain is checked
+// outward from each of them.
+static std::vector<RouteMatch> find_route_matches(uint32_t startSeed, RngBackend backend,
+                                                  const std::vector<RouteStep> &steps,
+                                                  int64_t minBase, int64_t maxBase, int maxResults) {
+    if (steps.empty()) return {};
+    std::vector<ResiduePredicate> preds;
+    size_t pivot = 0;
+    double pivotDensity = 2.0;
+    int64_t pivotLo = 0, pivotHi = 0, lo = 0, hi = 0;
+    for (size_t k = 0; k < steps.size(); ++k) {
+        if (k > 0) {
+            if (steps[k].offsetMin < 0 || steps[k].offsetMax < steps[k].offsetMin) return {};
+            lo += steps[k].offsetMin;
+            hi += steps[k].offsetMax;
+        }
+        preds.push_back(compile_route_predicate(steps[k]));
+        if (preds.back().empty()) return {};
+        double density = residue_predicate_density(preds.back());
+        if (density < pivotDensity) {
+            pivot = k;
+            pivotDensity = density;
+            pivotLo = lo;
+            pivotHi = hi;
+        }
+    }
+
+    return scan_sharded<RouteMatch>(startSeed, backend, minBase, maxBase, maxResults,
+        [&](const ScanShard &shard, std::vector<RouteMatch> &out) {
+            ScanShard hits = shard;
+            hits.first = shard.first + pivotLo;
+            hits.last = shard.last + pivotHi;
+            rng_advance(hits.seed, backend, (uint64_t)pivotLo);
+            std::vector<StreamHit> pivots;
+            scan_shard_predicate(hits, backend, preds[pivot], INT32_MAX, pivots,
+                [](int64_t adv, uint32_t seed, std::vector<StreamHit> &o) { o.push_back({adv, seed}); });
+
+            std::vector<RouteMatch> found;
+            for (const StreamHit &hit : pivots) {
+                if (shard.cancelled()) return;
+                route_chains_through(startSeed, backend, steps, preds, pivot, hit.adv,
+                                     shard.first, shard.last, found);
+            }
+            std::stable_sort(found.begin(), found.end(),
+                             [](const RouteMatch &a, const RouteMatch &b) { return a.baseAdvance < b.baseAdvance; });
+            for (RouteMatch &m : found) {
+                if (!out.empty() && out.back().baseAdvance == m.baseAdvance) continue;
+                out.push_back(std::move(m));
+                if ((int)out.size() >= maxResults) return;
+            }
+        });
+}
+
+// Global solver: every state of the backend's whole period at which the
+// route holds, for when the base seed is unknown (after a reset, or a long
+// idle). Seed 0's stream visits each state once per period, so a
+// full-period route scan from it finds them all, and each base advance is
+// that state's position relative to seed 0.
+static std::vector<RouteMatch> find_global_route_states(RngBackend backend, const std::vector<RouteStep> &steps,
+                                                        int maxResults) {
+    return find_route_matches(0u, backend, steps, 0, (int64_t)rng_period(backend) - 1, maxResults);
+}
+
+// Every pair (p1, p2) with `first` hitting at p1 in [minFirst, maxFirst],
+// `second` hitting at p2 and p2 - p1 in [gapMin, gapMax], ordered by p1
+// then p2. Both puzzles' hits are produced as sorted streams, one chunk of
+// p1 at a time, and joined with a sliding window over the second stream,
+// so the work is linear in the span however wide the gap is.
+struct GapPair {
+    StreamHit first;
+    StreamHit second;
+};
+
+static constexpr int64_t GAP_JOIN_CHUNK = int64_t(1) << 24;
+
+static std::vector<StreamHit> find_stream_hits(uint32_t startSeed, RngBackend backend,
+                                               const ResiduePredicate &pred, int64_t first, int64_t last) {
+    return scan_sharded<StreamHit>(startSeed, backend, first, last, INT32_MAX,
+        [&](const ScanShard &shard, std::vector<StreamHit> &out) {
+            scan_shard_predicate(shard, backend, pred, INT32_MAX, out,
+                [](int64_t adv, uint32_t seed, std::vector<StreamHit> &o) { o.push_back({adv, seed}); });
+        });
+}
+
+static std::vector<GapPair> find_gap_pairs(uint32_t startSeed, RngBackend backend,
+                                           const RouteStep &first, const RouteStep &second,
+                                           int64_t minFirst, int64_t maxFirst,
+                                           int64_t gapMin, int64_t gapMax, int maxResults) {
+    std::vector<GapPair> out;
+    minFirst = std::max<int64_t>(minFirst, 0);
+    if (maxFirst < minFirst || gapMin < 0 || gapMax < gapMin) return out;
+    const ResiduePredicate predFirst = compile_route_predicate(first);
+    const ResiduePredicate predSecond = compile_route_predicate(second);
+    if (predFirst.empty() || predSecond.empty()) return out;
+    const size_t quota = (size_t)std::max(maxResults, 1);
+
+    std::vector<StreamHit> window;      // hits of `second`, ascending
+    size_t windowFront = 0;
+    int64_t secondScanned = minFirst + gapMin - 1;
+
+    for (int64_t chunk = minFirst; chunk <= maxFirst; chunk += GAP_JOIN_CHUNK) {
+        const int64_t chunkLast = std::min(maxFirst, chunk + GAP_JOIN_CHUNK - 1);
+        const std::vector<StreamHit> hits = find_stream_hits(startSeed, backend, predFirst, chunk, chunkLast);
+        if (hits.empty()) continue;
+
+        const int64_t need = hits.back().adv + gapMax;
+        const int64_t from = std::max(secondScanned + 1, hits.front().adv + gapMin);
+        if (need >= from) {
+            // Drop what no later p1 can reach before growing the window.
+            while (windowFront < window.size() && window[windowFront].adv < hits.front().adv + gapMin) ++windowFront;
+            window.erase(window.begin(), window.begin() + (std::ptrdiff_t)windowFront);
+            windowFront = 0;
+            std::vector<StreamHit> more = find_stream_hits(startSeed, backend, predSecond, from, need);
+            window.insert(window.end(), more.begin(), more.end());
+            secondScanned = need;
+        }
+
+        for (const StreamHit &a : hits) {
+            while (windowFront < window.size() && window[windowFront].adv < a.adv + gapMin) ++windowFront;
+            for (size_t j = windowFront; j < window.size() && window[j].adv <= a.adv + gapMax; ++j) {
+                out.push_back({a, window[j]});
+                if (out.size() >= quota) return out;
+            }
+        }
+    }
+    return out;
+}
+
+// Outcome of a route step's puzzle at `seed`, packed like the puzzle's own
+// output (code nibbles, or HHMM for the clock).
+static uint32_t route_step_outcome(const RouteStep &step, uint32_t seed, RngBackend backend) {
+    switch (step.puzzle) {
+        case RoutePuzzle::Shakespeare: return SHAKESPEARE_CODES[draw_tuple<10>(seed, backend)];
+        case RoutePuzzle::Hospital3F:  return HOSPITAL3F_CODES[draw_tuple<9>(seed, backend)];
+        case RoutePuzzle::Crematorium: return gen_crematorium_meta_from_seed(seed, backend).codePacked;
+        case RoutePuzzle::Clock: break;
+    }
+    return gen_clock_puzzle(seed, 0, step.modeByte, backend, false);
+}
+
+static const char *route_puzzle_name(RoutePuzzle puzzle) {
+    switch (puzzle) {
+        case RoutePuzzle::Shakespeare: return "Shakespeare";
+        case RoutePuzzle::Hospital3F:  return "3F Hospital";
+        case RoutePuzzle::Crematorium: return "Crematorium";
+        case RoutePuzzle::Clock: break;
+    }
+    return "Clock";
+}
+
+// "HH:MM" (or HHMM) to packed clock digits; the hour is checked against the
+// mode byte by the clock predicate.
+static std::optional<uint32_t> parse_clock_time_input(const std::string &s) {
+    int digits[4];
+    int count = 0;
+    for (char ch : s) {
+        if (ch == ':' || std::isspace((unsigned char)ch)) continue;
+        if (ch < '0' || ch > '9' || count == 4) return std::nullopt;
+        digits[count++] = ch - '0';
+    }
+    if (count != 4 || digits[2] > 5) return std::nullopt;
+    return ((uint32_t)digits[0] << 12) | ((uint32_t)digits[1] << 8) | ((uint32_t)digits[2] << 4) | (uint32_t)digits[3];
+}
+
+// Prompts for a puzzle kind and its target ("*" for any) into `step`.
+static bool read_route_puzzle(const std::string &label, RouteStep &step) {
+    int kind = 1;
+    std::cout << "\n" << label << ": 1) Shakespeare 2) 3F Hospital 3) Crematorium 4) Clock: ";
+    std::cin >> kind;
+    step.puzzle = (kind == 2) ? RoutePuzzle::Hospital3F
+                : (kind == 3) ? RoutePuzzle::Crematorium
+                : (kind == 4) ? RoutePuzzle::Clock
+                              : RoutePuzzle::Shakespeare;
+
+    std::string targetStr;
+    std::optional<uint32_t> parsed;
+    if (step.puzzle == RoutePuzzle::Clock) {
+        std::cout << "Target time HH:MM, or * for any: ";
+        std::cin >> targetStr;
+        if (targetStr != "*") parsed = parse_clock_time_input(targetStr);
+        char modeInput;
+        std::cout << "24h path option (y/n): ";
+        std::cin >> modeInput;
+        step.modeByte = (modeInput == 'y' || modeInput == 'Y') ? 2 : 0;
+    } else {
+        std::cout << "Target code (4 digits like 0123), or * for any: ";
+        std::cin >> targetStr;
+        if (targetStr != "*") {
+            parsed = (step.puzzle == RoutePuzzle::Shakespeare) ? parse_shakespeare_code_input(targetStr)
+                   : (step.puzzle == RoutePuzzle::Hospital3F)  ? parse_hospital3f_code_input(targetStr)
+                                                               : parse_crematorium_code_input(targetStr);
+        }
+    }
+    step.any = (targetStr == "*");
+    if (!step.any) {
+        if (!parsed) {
+            std::cout << "Invalid target for " << route_puzzle_name(step.puzzle) << ".\n";
+            return false;
+        }
+        step.target = *parsed;
+    }
+    return true;
+}
+
+// Prints one puzzle outcome the way the route and gap modes list them.
+static void print_route_hit(const RouteStep &step, int64_t adv, uint32_t seed, RngBackend backend) {
+    uint32_t outcome = route_step_outcome(step, seed, backend);
+    std::cout << route_puzzle_name(step.puzzle) << " @" << adv
+              << "  seed=0x" << std::hex << std::uppercase << seed << std::dec << "  "
+              << ((outcome >> 12) & 0xF) << ((outcome >> 8) & 0xF)
+              << (step.puzzle == RoutePuzzle::Clock ? ":" : "")
+              << ((outcome >> 4) & 0xF) << (outcome & 0xF);
+}
+
+// Prompts for a route: its puzzles in generation order and the advance
+// range between each and the one before.
+static bool read_route_steps(std::vector<RouteStep> &steps) {
+    int stepCount = 0;
+    std::cout << "Number of puzzles in the route (in the order they are generated): ";
+    std::cin >> stepCount;
+    if (stepCount <= 0) {
+        std::cout << "A route needs at least one puzzle.\n";
+        return false;
+    }
+
+    for (int i = 0; i < stepCount; ++i) {
+        RouteStep step{RoutePuzzle::Shakespeare, true, 0u, 0, 0, 0};
+        if (!read_route_puzzle("Puzzle #" + std::to_string(i + 1), step)) return false;
+
+        if (i > 0) {
+            std::cout << "Advances after puzzle #" << i << " (min): ";
+            std::cin >> step.offsetMin;
+            std::cout << "Advances after puzzle #" << i << " (max): ";
+            std::cin >> step.offsetMax;
+            if (step.offsetMin < 0 || step.offsetMax < step.offsetMin) {
+                std::cout << "Offsets must satisfy 0 <= min <= max.\n";
+                return false;
+            }
+        }
+        steps.push_back(step);
+    }
+    return true;
+}
+
+static void print_route_matches(const std::vector<RouteStep> &steps, const std::vector<RouteMatch> &matches,
+                                uint32_t startSeed, RngBackend backend) {
+    std::cout << "\nRoute matches from seed 0x" << std::hex << std::uppercase << startSeed << std::dec
+              << " (each advance = 1 rand call):\n";
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const RouteMatch &m = matches[i];
+        std::cout << "  [" << i << "] base advances=" << m.baseAdvance
+                  << "  seed@advance=0x" << std::hex << std::uppercase << m.seedAtBase << std::dec << "\n";
+        for (size_t k = 0; k < steps.size(); ++k) {
+            uint32_t seed = startSeed;
+            rng_advance(seed, backend, (uint64_t)m.positions[k]);
+            std::cout << "      #" << (k + 1) << " ";
+            print_route_hit(steps[k], m.positions[k], seed, backend);
+            if (k > 0) std::cout << "  (+" << (m.positions[k] - m.positions[k - 1]) << ")";
+            std::cout << "\n";
+        }
+    }
+}
+
+// Timeline: the outcome of every puzzle at each advance of a window, from
+// one pass over the shared output stream. The draws at advance a give the
+// Shakespeare and 3F hospital codes, the crematorium code with its forced-7
+// position, and the clock time. The 12h and 24h clock paths use the same
+// two draws and differ only in the hour label, so one value covers both.
+struct TimelineEntry {
+    int64_t adv;
+    uint32_t seed;
+    uint16_t shakespeareTuple;
+    uint16_t hospital3fTuple;
+    uint16_t crematoriumKey;    // Shakespeare-style tuple of the final code
+    int8_t forcedPos;           // -1 when the code drew its own 7
+    uint8_t hourRem;            // rHour % 12
+    uint8_t minute;
+};
+
+static SH3_ALWAYS_INLINE TimelineEntry timeline_entry(const IndexKeyTables &tables, int64_t adv, uint32_t seed,
+                                                      const uint32_t *o) {
+    uint32_t t10 = ((o[0] % 10 * 9 + o[1] % 9) * 8 + o[2] % 8) * 7 + o[3] % 7;
+    uint32_t t9 = ((o[0] % 9 * 8 + o[1] % 8) * 7 + o[2] % 7) * 6 + o[3] % 6;
+    int pos = CREMATORIUM_CODES[t10].has7 ? -1 : (int)(o[4] % 4u);
+    return {adv, seed, (uint16_t)t10, (uint16_t)t9, tables.cremKey[t10 * 4 + (pos < 0 ? 0 : pos)],
+            (int8_t)pos, (uint8_t)(o[0] % 12), (uint8_t)(o[1] % 60)};
+}
+
+// Calls fn(shard, entry) for every advance of the shard, in order.
+template <typename Fn>
+static void timeline_shard(const IndexKeyTables &tables, const ScanShard &shard, RngBackend backend, Fn fn) {
+    with_backend(backend, [&](auto policy) {
+        stream_shard_blocks<decltype(policy)>(shard, [&](int64_t base, const uint32_t *o, const uint32_t *states) {
+            const int rows = (int)std::min<int64_t>(STREAM_BLOCK, shard.last - base + 1);
+            for (int k = 0; k < rows; ++k) fn(timeline_entry(tables, base + k, states[k], o + k));
+            return true;
+        });
+    });
+}
+
+// Per-outcome counts over a window, indexed like TimelineEntry's fields;
+// clock counts are indexed by hourRem * 60 + minute.
+struct TimelineHistogram {
+    uint64_t advances = 0;
+    std::vector<uint64_t> shakespeare, hospital3f, crematorium, crematoriumForced, clock;
+
+    TimelineHistogram()
+        : shakespeare(SHAKESPEARE_TUPLES), hospital3f(HOSPITAL3F_TUPLES), crematorium(SHAKESPEARE_TUPLES),
+          crematoriumForced(SHAKESPEARE_TUPLES), clock(12 * 60) {}
+
+    void add(const TimelineEntry &e) {
+        ++advances;
+        ++shakespeare[e.shakespeareTuple];
+        ++hospital3f[e.hospital3fTuple];
+        ++crematorium[e.crematoriumKey];
+        if (e.forcedPos >= 0) ++crematoriumForced[e.crematoriumKey];
+        ++clock[e.hourRem * 60u + e.minute];
+    }
+
+    void merge(const TimelineHistogram &o) {
+        advances += o.advances;
+        for (size_t i = 0; i < shakespeare.size(); ++i) shakespeare[i] += o.shakespeare[i];
+        for (size_t i = 0; i < hospital3f.size(); ++i) hospital3f[i] += o.hospital3f[i];
+        for (size_t i = 0; i < crematorium.size(); ++i) crematorium[i] += o.crematorium[i];
+        for (size_t i = 0; i < crematoriumForced.size(); ++i) crematoriumForced[i] += o.crematoriumForced[i];
+        for (size_t i = 0; i < clock.size(); ++i) clock[i] += o.clock[i];
+    }
+};
+
+// Entries come back in chunks of this many advances, so a long timeline
+// streams out instead of being held in memory.
+static constexpr int64_t TIMELINE_CHUNK = int64_t(1) << 22;
+
+// Calls emit(entries) with consecutive chunks of the timeline of [first, last].
+template <typename EmitFn>
+static void find_timeline(uint32_t startSeed, RngBackend backend, int64_t first, int64_t last, EmitFn emit) {
+    static const IndexKeyTables tables;
+    for (int64_t chunk = std::max<int64_t>(first, 0); chunk <= last; chunk += TIMELINE_CHUNK) {
+        const int64_t chunkLast = std::min(last, chunk + TIMELINE_CHUNK - 1);
+        emit(scan_sharded<TimelineEntry>(startSeed, backend, chunk, chunkLast, INT32_MAX,
+            [&](const ScanShard &shard, std::vector<TimelineEntry> &out) {
+                out.reserve((size_t)(shard.last - shard.first + 1));
+                timeline_shard(tables, shard, backend, [&](const TimelineEntry &e) { out.push_back(e); });
+            }));
+    }
+}
+
+static TimelineHistogram find_timeline_histogram(uint32_t startSeed, RngBackend backend, int64_t first, int64_t last) {
+    static const IndexKeyTables tables;
+    TimelineHistogram total;
+    for (const TimelineHistogram &h : scan_sharded<TimelineHistogram>(startSeed, backend, first, last, INT32_MAX,
+             [&](const ScanShard &shard, std::vector<TimelineHistogram> &out) {
+                 out.emplace_back();
+                 TimelineHistogram &h = out.back();
+                 timeline_shard(tables, shard, backend, [&](const TimelineEntry &e) { h.add(e); });
+             })) {
+        total.merge(h);
+    }
+    return total;
+}
+
+static void print_packed_code(uint32_t code) {
+    std::cout << ((code >> 12) & 0xF) << ((code >> 8) & 0xF) << ((code >> 4) & 0xF) << (code & 0xF);
+}
+
+static void print_clock_rem(int hourRem, int minute, uint8_t modeByte) {
+    int hour = hourRem + ((modeByte == 2) ? 12 : 1);
+    std::cout << (hour < 10 ? "0" : "") << hour << ":" << (minute < 10 ? "0" : "") << minute;
+}
+
+static void print_timeline_entry(const TimelineEntry &e) {
+    std::cout << std::setw(10) << e.adv << "  " << std::hex << std::uppercase << std::setw(8) << std::setfill('0')
+              << e.seed << std::dec << std::setfill(' ') << "  ";
+    print_packed_code(SHAKESPEARE_CODES[e.shakespeareTuple]);
+    std::cout << "  ";
+    print_packed_code(HOSPITAL3F_CODES[e.hospital3fTuple]);
+    std::cout << "  ";
+    print_packed_code(SHAKESPEARE_CODES[e.crematoriumKey]);
+    std::cout << (e.forcedPos >= 0 ? "*" : " ") << (e.forcedPos >= 0 ? (char)('0' + e.forcedPos) : ' ') << "  ";
+    print_clock_rem(e.hourRem, e.minute, 0);
+    std::cout << "  ";
+    print_clock_rem(e.hourRem, e.minute, 2);
+    std::cout << "\n";
+}
+
+// Lists the `top` most frequent outcomes (all when top is 0) of one puzzle;
+// label(i) prints outcome i and extra(i) anything after its count.
+template <typename LabelFn, typename ExtraFn>
+static void print_histogram(const char *name, const std::vector<uint64_t> &counts, uint64_t advances, size_t top,
+                            LabelFn label, ExtraFn extra) {
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < counts.size(); ++i) {
+        if (counts[i]) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+    std::cout << "\n" << name << ": " << order.size() << " distinct outcomes";
+    if (!order.empty()) {
+        std::cout << ", most frequent " << counts[order.front()] << "x, least " << counts[order.back()] << "x";
+    }
+    std::cout << "\n";
+    if (top && order.size() > top) order.resize(top);
+    for (uint32_t i : order) {
+        std::cout << "  ";
+        label(i);
+        std::cout << "  " << std::setw(10) << counts[i] << "  " << std::fixed << std::setprecision(4)
+                  << 100.0 * (double)counts[i] / (double)advances << "%";
+        std::cout.unsetf(std::ios::floatfield);
+        extra(i);
+        std::cout << "\n";
+    }
+}
+
+static void print_timeline_histogram(const TimelineHistogram &h, size_t top) {
+    auto none = [](uint32_t) {};
+    print_histogram("Shakespeare", h.shakespeare, h.advances, top,
+                    [](uint32_t i) { print_packed_code(SHAKESPEARE_CODES[i]); }, none);
+    print_histogram("3F Hospital", h.hospital3f, h.advances, top,
+                    [](uint32_t i) { print_packed_code(HOSPITAL3F_CODES[i]); }, none);
+    print_histogram("Crematorium", h.crematorium, h.advances, top,
+                    [](uint32_t i) { print_packed_code(SHAKESPEARE_CODES[i]); },
+                    [&](uint32_t i) {
+                        if (h.crematoriumForced[i]) std::cout << "  (forced 7: " << h.crematoriumForced[i] << ")";
+                    });
+    print_histogram("Clock (12h / 24h)", h.clock, h.advances, top,
+                    [](uint32_t i) {
+                        print_clock_rem((int)(i / 60), (int)(i % 60), 0);
+                        std::cout << " / ";
+                        print_clock_rem((int)(i / 60), (int)(i % 60), 2);
+                    },
+                    none);
+}
+
+// Batch mode: `seedhill3 --batch [file]` reads one query per line (from
+// stdin when no file or "-") and writes one JSON object per query to
+// stdout, in input order. A query is either whitespace-separated key=value
+// pairs or a flat JSON object, e.g.
+//   mode=4 backend=ps2 seed=0 code=1234 min=0 max=5000000 limit=20
+//   {"id": "q7", "mode": 7, "seed": "0", "hour": 10, "minute": 25, "h24": false}
+// Keys follow the interactive prompts: seed / first / targets are hex,
+// warmup, min, max, limit, hour and minute decimal, code a 4-digit code,
+// h24 a yes/no flag, and targets a comma-separated list (mode 12). backend
+// is ps2 (or p) or pc (or c). max may also be "full", for the whole period.
+// An "id" and the backend used are echoed back. Blank lines and lines
+// starting with '#' are skipped.
+//
+// Reverse searches (modes 4, 6, 7, 9, 11) on the same backend and base
+// seed share one pass over the stream: each block of rand31 outputs is
+// drawn once and every query's predicate is evaluated on it. Queries an
+// advance index fully covers are answered from the index instead.
+using BatchFields = std::map<std::string, std::string>;
+
+struct BatchJob {
+    BatchFields fields;
+    int mode = 0;
+    RngBackend backend = RngBackend::PS2;
+    uint32_t seed = 0;
+    std::string error;
+
+    // Reverse searches.
+    bool scan = false;
+    ResiduePredicate pred;
+    int64_t first = 0, last = 0;
+    size_t quota = 1;
+    uint32_t code = 0;
+    uint8_t modeByte = 0;
+    bool matchHour = true, matchMinute = true;
+    std::vector<StreamHit> hits;
+};
+
+// Passes over a shared stream advance this many advances at a time, so
+// queries that have all their matches stop being evaluated.
+static constexpr int64_t BATCH_PASS_CHUNK = int64_t(1) << 26;
+
+static bool batch_parse_json(const std::string &line, BatchFields &fields) {
+    size_t i = 0;
+    auto skipSpace = [&]() { while (i < line.size() && std::isspace((unsigned char)line[i])) ++i; };
+    auto readString = [&](std::string &out) {
+        if (i >= line.size() || line[i] != '"') return false;
+        for (++i; i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) ++i;
+            out.push_back(line[i]);
+        }
+        if (i >= line.size()) return false;
+        ++i;
+        return true;
+    };
+    auto readScalar = [&](std::string &out) {
+        skipSpace();
+        if (i < line.size() && line[i] == '"') return readString(out);
+        while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ']' &&
+               !std::isspace((unsigned char)line[i])) {
+            out.push_back(line[i++]);
+        }
+        return !out.empty();
+    };
+
+    skipSpace();
+    if (i >= line.size() || line[i] != '{') return false;
+    ++i;
+    for (;;) {
+        skipSpace();
+        if (i < line.size() && line[i] == '}') return true;
+        std::string key, value;
+        if (!readString(key)) return false;
+        skipSpace();
+        if (i >= line.size() || line[i] != ':') return false;
+        ++i;
+        skipSpace();
+        if (i < line.size() && line[i] == '[') {
+            // Arrays of scalars (mode 12 targets) become comma-separated lists.
+            ++i;
+            for (;;) {
+                skipSpace();
+                if (i < line.size() && line[i] == ']') { ++i; break; }
+                std::string item;
+                if (!readScalar(item)) return false;
+                value += (value.empty() ? "" : ",") + item;
+                skipSpace();
+                if (i < line.size() && line[i] == ',') ++i;
+            }
+        } else if (!readScalar(value)) {
+            return false;
+        }
+        fields[key] = value;
+        skipSpace();
+        if (i < line.size() && line[i] == ',') ++i;
+    }
+}
+
+static bool batch_parse_line(const std::string &line, BatchFields &fields) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start != std::string::npos && line[start] == '{') return batch_parse_json(line, fields);
+    std::istringstream in(line);
+    std::string token;
+    while (in >> token) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos || eq == 0) return false;
+        fields[token.substr(0, eq)] = token.substr(eq + 1);
+    }
+    return !fields.empty();
+}
+
+static std::string json_string(const std::string &s) {
+    std::string out = "\"";
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') out.push_back('\\');
+        if ((unsigned char)ch < 0x20) continue;
+        out.push_back(ch);
+    }
+    return out + "\"";
+}
+
+static std::string hex_string(uint32_t v) {
+    std::ostringstream out;
+    out << std::hex << std::uppercase << v;
+    return out.str();
+}
+
+static std::string code_string(uint32_t packed) {
+    std::string out;
+    for (int shift = 12; shift >= 0; shift -= 4) out.push_back((char)('0' + ((packed >> shift) & 0xF)));
+    return out;
+}
+
+static std::string clock_string(uint32_t packed) {
+    std::string digits = code_string(packed);
+    return digits.substr(0, 2) + ":" + digits.substr(2);
+}
+
+// Reads a field; returns false (leaving `out` alone) when it is absent.
+static bool batch_field(const BatchJob &job, const char *key, std::string &out) {
+    auto it = job.fields.find(key);
+    if (it == job.fields.end()) return false;
+    out = it->second;
+    return true;
+}
+
+static int64_t batch_int(const BatchJob &job, const char *key, int64_t fallback) {
+    std::string v;
+    return batch_field(job, key, v) ? std::strtoll(v.c_str(), nullptr, 10) : fallback;
+}
+
+static uint32_t batch_hex(const BatchJob &job, const char *key, uint32_t fallback) {
+    std::string v;
+    return batch_field(job, key, v) ? (uint32_t)std::strtoul(v.c_str(), nullptr, 16) : fallback;
+}
+
+static bool batch_flag(const BatchJob &job, const char *key) {
+    std::string v;
+    if (!batch_field(job, key, v) || v.empty()) return false;
+    return v == "true" || v[0] == 'y' || v[0] == 'Y' || v == "1";
+}
+
+// Validates a query and, for reverse searches, compiles its predicate.
+static void batch_prepare(BatchJob &job) {
+    job.mode = (int)batch_int(job, "mode", 0);
+    std::string backendText = "ps2";
+    batch_field(job, "backend", backendText);
+    for (char &ch : backendText) ch = (char)std::tolower((unsigned char)ch);
+    if (backendText == "p" || backendText == "ps2") {
+        job.backend = RngBackend::PS2;
+    } else if (backendText == "c" || backendText == "pc") {
+        job.backend = RngBackend::PC;
+    } else {
+        job.error = "invalid backend";
+        return;
+    }
+    job.seed = batch_hex(job, "seed", 0u);
+    job.modeByte = batch_flag(job, "h24") ? 2 : 0;
+    if (job.mode < 1 || job.mode > 12) {
+        job.error = "mode must be 1-12";
+        return;
+    }
+    if (job.mode != 4 && job.mode != 6 && job.mode != 7 && job.mode != 9 && job.mode != 11) return;
+
+    const int64_t defaultMax = (job.mode == 7) ? 5000 : (job.mode == 6) ? 500000 : 5000000;
+    job.first = std::max<int64_t>(batch_int(job, "min", 0), 0);
+    std::string maxText;
+    const int64_t fullPeriod = (int64_t)rng_period(job.backend) - 1;
+    job.last = std::max((batch_field(job, "max", maxText) && maxText == "full") ? fullPeriod
+                                                                               : batch_int(job, "max", defaultMax),
+                        job.first);
+    const int64_t limit = batch_int(job, "limit", 20);
+    if (limit <= 0) {
+        job.error = "limit must be > 0";
+        return;
+    }
+    job.quota = (size_t)std::min<int64_t>(limit, INT32_MAX);
+
+    std::string codeText;
+    if (job.mode == 4 || job.mode == 9 || job.mode == 11) {
+        if (!batch_field(job, "code", codeText)) {
+            job.error = "missing code";
+            return;
+        }
+        std::optional<uint32_t> code = (job.mode == 4) ? parse_shakespeare_code_input(codeText)
+                                     : (job.mode == 9) ? parse_hospital3f_code_input(codeText)
+                                                       : parse_crematorium_code_input(codeText);
+        if (!code) {
+            job.error = "invalid code";
+            return;
+        }
+        job.code = *code;
+        job.pred = (job.mode == 4) ? compile_code_predicate(job.code, 0, 10)
+                 : (job.mode == 9) ? compile_code_predicate(job.code, 1, 9)
+                                   : compile_crematorium_predicate(job.code);
+    } else if (job.mode == 7) {
+        int hour = (int)batch_int(job, "hour", -1);
+        int minute = (int)batch_int(job, "minute", -1);
+        std::string timeText;
+        if (batch_field(job, "time", timeText)) {
+            auto packed = parse_clock_time_input(timeText);
+            if (!packed) {
+                job.error = "invalid time";
+                return;
+            }
+            hour = (int)((*packed >> 12) & 0xF) * 10 + (int)((*packed >> 8) & 0xF);
+            minute = (int)((*packed >> 4) & 0xF) * 10 + (int)(*packed & 0xF);
+        }
+        job.pred = compile_clock_warmups_predicate(job.modeByte, hour, minute);
+    } else {
+        job.matchHour = job.fields.count("hour") != 0;
+        job.matchMinute = job.fields.count("minute") != 0;
+        if (!job.matchHour && !job.matchMinute) job.matchHour = job.matchMinute = true;
+        job.pred = compile_clock_flexible_predicate(job.modeByte, job.matchHour, job.matchMinute,
+                                                    (int)batch_int(job, "hour", 0), (int)batch_int(job, "minute", 0));
+    }
+
+    // Code searches the index covers entirely go straight to the finder.
+    if (job.mode != 6 && job.mode != 7 && !job.pred.empty()) {
+        const AdvanceIndex *index = advance_index(job.backend);
+        if (index && index->header.baseSeed == job.seed && job.last < (int64_t)index->header.horizon) {
+            const int quota = (int)job.quota;
+            if (job.mode == 4) {
+                for (const auto &m : find_shakespeare_seeds_for_code(job.seed, job.code, quota, job.backend, job.first, job.last))
+                    job.hits.push_back({m.advances, m.seedAfterWarmup});
+            } else if (job.mode == 9) {
+                for (const auto &m : find_hospital3f_seeds_for_code(job.seed, job.code, quota, job.backend, job.first, job.last))
+                    job.hits.push_back({m.advances, m.seedAfterWarmup});
+            } else {
+                for (const auto &m : find_crematorium_seeds_for_code(job.seed, job.code, quota, job.backend, job.first, job.last))
+                    job.hits.push_back({m.advances, m.seedAfterWarmup});
+            }
+            return;
+        }
+    }
+    job.scan = !job.pred.empty();
+}
+
+// One pass over the stream from (seed, backend) answering every query in
+// `jobs`. Each shard draws its outputs once; per block, every query whose
+// range overlaps and whose shard quota is open runs its predicate on them.
+static void batch_shared_pass(uint32_t seed, RngBackend backend, const std::vector<BatchJob *> &jobs) {
+    if (jobs.size() == 1) {
+        // A lone query gets the ordinary scan, PS2 sieve included.
+        BatchJob &job = *jobs.front();
+        job.hits = scan_sharded<StreamHit>(seed, backend, job.first, job.last, (int)job.quota,
+            [&](const ScanShard &shard, std::vector<StreamHit> &out) {
+                scan_shard_predicate(shard, backend, job.pred, (int)job.quota, out,
+                    [](int64_t adv, uint32_t s, std::vector<StreamHit> &o) { o.push_back({adv, s}); });
+            });
+        return;
+    }
+
+    int64_t first = INT64_MAX, last = -1;
+    for (const BatchJob *job : jobs) {
+        first = std::min(first, job->first);
+        last = std::max(last, job->last);
+    }
+
+    using ShardHits = std::vector<std::vector<StreamHit>>;
+    for (int64_t chunk = first; chunk <= last; chunk += BATCH_PASS_CHUNK) {
+        if (scan_abort && scan_abort->aborted()) return;
+        const int64_t chunkLast = std::min(last, chunk + BATCH_PASS_CHUNK - 1);
+        std::vector<BatchJob *> active;
+        for (BatchJob *job : jobs) {
+            if (job->hits.size() < job->quota && job->first <= chunkLast && job->last >= chunk) active.push_back(job);
+        }
+        if (active.empty()) {
+            bool pending = false;
+            for (const BatchJob *job : jobs) pending |= job->hits.size() < job->quota && job->last > chunkLast;
+            if (!pending) return;
+            continue;
+        }
+
+        std::vector<ShardHits> shards = scan_sharded<ShardHits>(seed, backend, chunk, chunkLast, INT32_MAX,
+            [&](const ScanShard &shard, std::vector<ShardHits> &out) {
+                ShardHits hits(active.size());
+                uint32_t masks[STREAM_GROUPS];
+                auto block = [&](int64_t base, const uint32_t *o, const uint32_t *states) {
+                    const int64_t blockLast = base + STREAM_BLOCK - 1;
+                    for (size_t q = 0; q < active.size(); ++q) {
+                        const BatchJob &job = *active[q];
+                        if (job.first > blockLast || job.last < base || hits[q].size() >= job.quota) continue;
+                        int checked = lanes_leading_stages(job.pred, o, o + 1, masks);
+                        if (shard.tally) stats_tally_leading(*shard.tally, job.pred, o, checked, masks);
+                        if (checked != job.pred.draws || !lanes_leading_stages_exact(job.pred)) {
+                            lanes_filter_survivors(job.pred, masks, [&](int r, uint32_t *) { return o + r; },
+                                                   shard.tally);
+                        }
+                        for (int g = 0; g < STREAM_GROUPS; ++g) {
+                            for (uint32_t mask = masks[g]; mask; mask &= mask - 1) {
+                                int k = g * SIMD_LANES + __builtin_ctz(mask);
+                                int64_t adv = base + k;
+                                if (adv < job.first || adv > job.last || adv > shard.last) continue;
+                                if (hits[q].size() >= job.quota) continue;
+                                hits[q].push_back({adv, states[k]});
+                                if (shard.tally) shard.tally->matches++;
+                            }
+                        }
+                    }
+                    return true;
+                };
+                with_backend(backend, [&](auto policy) { stream_shard_blocks<decltype(policy)>(shard, block); });
+                out.push_back(std::move(hits));
+            });
+
+        for (const ShardHits &shard : shards) {
+            for (size_t q = 0; q < active.size(); ++q) {
+                BatchJob &job = *active[q];
+                for (const StreamHit &hit : shard[q]) {
+                    if (job.hits.size() >= job.quota) break;
+                    job.hits.push_back(hit);
+                }
+            }
+        }
+    }
+}
+
+static std::string batch_hit_json(const BatchJob &job, const StreamHit &hit) {
+    std::ostringstream out;
+    out << "{\"advances\":" << hit.adv << ",\"seed\":" << json_string(hex_string(hit.seed));
+    if (job.mode == 11) {
+        CrematoriumMeta meta = gen_crematorium_meta_from_seed(hit.seed, job.backend);
+        out << ",\"code\":" << json_string(code_string(meta.codePacked))
+            << ",\"forced7\":" << (meta.forced7 ? "true" : "false");
+        if (meta.forced7) out << ",\"forcedPosLSB\":" << meta.forcedPosLSB;
+    } else if (job.mode == 6 || job.mode == 7) {
+        ClockWarmupMatch m = make_clock_match(hit.adv, hit.seed, job.modeByte, job.backend,
+                                              job.matchHour, job.matchMinute);
+        if (job.matchHour && job.matchMinute) {
+            out << ",\"time\":" << json_string(clock_string(m.packed));
+        } else if (job.matchHour) {
+            out << ",\"hour\":" << ((m.packed >> 12) & 0xF) * 10 + ((m.packed >> 8) & 0xF);
+        } else {
+            out << ",\"minute\":" << ((m.packed >> 4) & 0xF) * 10 + (m.packed & 0xF);
+        }
+    }
+    out << "}";
+    return out.str();
+}
+
+// The result fields of a query that is not a shared reverse search.
+static std::string batch_direct_result(BatchJob &job) {
+    std::ostringstream out;
+    const int64_t warmup = std::max<int64_t>(batch_int(job, "warmup", 0), 0);
+    switch (job.mode) {
+        case 1:
+        case 3:
+            out << "\"code\":" << json_string(code_string(gen_shakespeare_code(job.seed, warmup, job.backend)));
+            break;
+        case 2: {
+            auto w = find_warmup_for_first(job.seed, batch_hex(job, "first", 0u), job.backend);
+            if (!w) {
+                job.error = "warmup not found in search range";
+                return "";
+            }
+            out << "\"warmup\":" << *w << ",\"code\":"
+                << json_string(code_string(gen_shakespeare_code(job.seed, (int64_t)*w, job.backend)));
+            break;
+        }
+        case 5:
+            out << "\"time\":" << json_string(clock_string(gen_clock_puzzle(job.seed, warmup, job.modeByte, job.backend)));
+            break;
+        case 8:
+            out << "\"code\":" << json_string(code_string(gen_hospital3f_code(job.seed, warmup, job.backend)));
+            break;
+        case 10: {
+            uint32_t seed = job.seed;
+            rng_advance(seed, job.backend, (uint64_t)warmup);
+            CrematoriumMeta meta = gen_crematorium_meta_from_seed(seed, job.backend);
+            out << "\"code\":" << json_string(code_string(meta.codePacked))
+                << ",\"forced7\":" << (meta.forced7 ? "true" : "false");
+            if (meta.forced7) out << ",\"forcedPosLSB\":" << meta.forcedPosLSB;
+            break;
+        }
+        case 12: {
+            std::string list;
+            batch_field(job, "targets", list);
+            std::istringstream targets(list);
+            std::string target;
+            uint32_t current = job.seed;
+            uint64_t total = 0;
+            out << "\"segments\":[";
+            for (bool firstSegment = true; std::getline(targets, target, ','); firstSegment = false) {
+                uint32_t next = (uint32_t)std::strtoul(target.c_str(), nullptr, 16);
+                auto dist = find_seed_distance(current, next, job.backend);
+                out << (firstSegment ? "" : ",") << "{\"target\":" << json_string(hex_string(next)) << ",\"advances\":";
+                if (dist) {
+                    out << *dist;
+                    total += *dist;
+                    current = next;
+                } else {
+                    out << "null";
+                }
+                out << "}";
+            }
+            out << "],\"total\":" << total;
+            break;
+        }
+        default: {
+            out << "\"matches\":[";
+            for (size_t i = 0; i < job.hits.size(); ++i) out << (i ? "," : "") << batch_hit_json(job, job.hits[i]);
+            out << "]";
+            break;
+        }
+    }
+    return out.str();
+}
+
+// Runs the shared passes for every prepared reverse search in `jobs`,
+// grouped by stream.
+static void batch_answer(std::vector<BatchJob> &jobs) {
+    std::map<std::pair<int, uint32_t>, std::vector<BatchJob *>> streams;
+    for (BatchJob &job : jobs) {
+        if (job.error.empty() && job.scan) streams[{(int)job.backend, job.seed}].push_back(&job);
+    }
+    for (auto &stream : streams) {
+        batch_shared_pass(stream.first.second, (RngBackend)stream.first.first, stream.second);
+    }
+}
+
+// The JSON line for an answered query.
+static std::string batch_response(BatchJob &job) {
+    std::string result = job.error.empty() ? batch_direct_result(job) : "";
+    std::ostringstream out;
+    out << "{";
+    auto id = job.fields.find("id");
+    if (id != job.fields.end()) out << "\"id\":" << json_string(id->second) << ",";
+    out << "\"mode\":" << job.mode << ",";
+    if (job.error.empty()) {
+        out << "\"backend\":\"" << (job.backend == RngBackend::PS2 ? "ps2" : "pc") << "\",\"ok\":true," << result;
+    } else {
+        out << "\"ok\":false,\"error\":" << json_string(job.error);
+    }
+    out << "}";
+    return out.str();
+}
+
+static int run_batch(const std::string &path) {
+    std::ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            std::cout << "Cannot open " << path << "\n";
+            return 1;
+        }
+    }
+    std::istream &in = (path == "-") ? std::cin : file;
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+        BatchJob job;
+        if (!batch_parse_line(line, job.fields)) job.error = "cannot parse query";
+        else batch_prepare(job);
+        jobs.push_back(std::move(job));
+    }
+
+    QueryStatsScope statsScope;
+    batch_answer(jobs);
+    for (BatchJob &job : jobs) std::cout << batch_response(job) << std::endl;
+    // The shared passes answer many queries at once, so a batch gets one
+    // stats line for the whole run.
+    if (statsScope.stats) std::cout << "{\"stats\":" << statsScope.stats->json() << "}" << std::endl;
+    return 0;
+}
+
+// Server mode: `seedhill3 --serve [socketPath]` answers batch-mode queries
+// one line at a time, over stdin/stdout or, given a path, for any number
+// of clients on a Unix domain socket. Every request line gets one response
+// line that carries the request's id. Responses may come back out of
+// order. Requests run on a fixed pool of SH3_SERVER_WORKERS workers
+// (default 4), and each worker still shards its scans over SH3_THREADS.
+// The advance index stays mapped between requests, and recent answers are
+// cached by query.
+//
+// A request with a "session" field supersedes every earlier request in the
+// same session, from any client. For example, a UI can send one session per
+// input box. A superseded request that is still queued or scanning stops
+// and answers {"ok":false,"error":"superseded"}. Requests without a session
+// always run to completion.
+static constexpr size_t SERVER_CACHE_SIZE = 256;
+
+struct ServerClient {
+    int fd = -1;                    // -1 writes to stdout
+    std::mutex writeMutex;
+
+    ~ServerClient() {
+#if defined(SH3_HAVE_SOCKETS)
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    void send(const std::string &line) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (fd < 0) {
+            std::cout << line << std::endl;
+            return;
+        }
+#if defined(SH3_HAVE_SOCKETS)
+        std::string data = line + "\n";
+        for (size_t done = 0; done < data.size();) {
+            ssize_t n = write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;     // client went away
+            done += (size_t)n;
+        }
+#endif
+    }
+};
+
+// The latest ticket handed out in a session. A named session stays in
+// QueryServer::sessions only while it has requests in flight.
+struct ServerSession {
+    std::atomic<uint64_t> latest{0};
+    size_t pending = 0;             // guarded by QueryServer::mutex
+};
+
+struct ServerRequest {
+    std::shared_ptr<ServerClient> client;
+    std::shared_ptr<ServerSession> session;
+    std::string sessionName;        // empty for a request without a session
+    uint64_t ticket;
+    BatchJob job;
+};
+
+struct QueryServer {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<ServerRequest> queue;
+    bool closing = false;
+    std::map<std::string, std::shared_ptr<ServerSession>> sessions;
+    // Most recent answer first; index maps a query's key to its entry.
+    std::list<std::pair<std::string, std::string>> cache;
+    std::map<std::string, std::list<std::pair<std::string, std::string>>::iterator> cacheIndex;
+    std::vector<std::thread> workers;
+
+    explicit QueryServer(unsigned workerCount) {
+        for (unsigned i = 0; i < workerCount; ++i) workers.emplace_back([this]() { work(); });
+    }
+
+    // Lets the queued requests finish, then stops the workers.
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    void submit(const std::shared_ptr<ServerClient> &client, const std::string &line) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') return;
+
+        ServerRequest req;
+        req.client = client;
+        if (!batch_parse_line(line, req.job.fields)) req.job.error = "cannot parse query";
+        req.job.mode = (int)batch_int(req.job, "mode", 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (batch_field(req.job, "session", req.sessionName)) {
+                std::shared_ptr<ServerSession> &named = sessions[req.sessionName];
+                if (!named) named = std::make_shared<ServerSession>();
+                req.session = named;
+                ++req.session->pending;
+            } else {
+                req.session = std::make_shared<ServerSession>();
+            }
+            req.ticket = req.session->latest.fetch_add(1) + 1;
+            queue.push_back(std::move(req));
+        }
+        wake.notify_one();
+    }
+
+    // Everything but id and session, so repeated queries share an entry.
+    static std::string cache_key(const BatchJob &job) {
+        std::string key;
+        for (const auto &field : job.fields) {
+            if (field.first == "id" || field.first == "session") continue;
+            key += field.first + "=" + field.second + ";";
+        }
+        return key;
+    }
+
+    // Cached answers are stored without their id.
+    bool cache_lookup(const std::string &key, std::string &answer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cacheIndex.find(key);
+        if (it == cacheIndex.end()) return false;
+        cache.splice(cache.begin(), cache, it->second);
+        answer = it->second->second;
+        return true;
+    }
+
+    void cache_store(const std::string &key, const std::string &answer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cacheIndex.count(key)) return;
+        cache.emplace_front(key, answer);
+        cacheIndex[key] = cache.begin();
+        if (cache.size() > SERVER_CACHE_SIZE) {
+            cacheIndex.erase(cache.back().first);
+            cache.pop_back();
+        }
+    }
+
+    void work() {
+        for (;;) {
+            ServerRequest req;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return closing || !queue.empty(); });
+                if (queue.empty()) return;
+                req = std::move(queue.front());
+                queue.pop_front();
+            }
+            req.client->send(answer(req));
+            if (!req.sessionName.empty()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--req.session->pending == 0) sessions.erase(req.sessionName);
+            }
+        }
+    }
 
-    for (int i = 0; i < minAdvances; ++i) {
-        rng_next31(seedWarm, backend);
+    std::string answer(ServerRequest &req) {
+        BatchJob &job = req.job;
+        const ScanAbort abort{&req.session->latest, req.ticket};
+        if (abort.aborted()) job.error = "superseded";
+        if (!job.error.empty()) return batch_response(job);
+
+        const std::string key = cache_key(job);
+        std::string cached;
+        if (cache_lookup(key, cached)) {
+            auto id = job.fields.find("id");
+            if (id == job.fields.end()) return cached;
+            return "{\"id\":" + json_string(id->second) + "," + cached.substr(1);
+        }
+
+        std::vector<BatchJob> jobs(1);
+        jobs.front().fields = job.fields;
+        jobs.front().fields.erase("id");
+        QueryStatsScope statsScope;
+        scan_abort = &abort;
+        batch_prepare(jobs.front());
+        batch_answer(jobs);
+        std::string body = batch_response(jobs.front());
+        scan_abort = nullptr;
+        if (abort.aborted()) {
+            job.error = "superseded";
+            return batch_response(job);
+        }
+        if (jobs.front().error.empty()) cache_store(key, body);
+        // Stats belong to this run only, so they stay out of the cache.
+        if (statsScope.stats) body.insert(body.size() - 1, ",\"stats\":" + statsScope.stats->json());
+
+        auto id = job.fields.find("id");
+        if (id == job.fields.end()) return body;
+        return "{\"id\":" + json_string(id->second) + "," + body.substr(1);
+    }
+
+#if defined(SH3_HAVE_SOCKETS)
+    // Reads request lines from one socket client until it disconnects.
+    void serve_client(int fd) {
+        auto client = std::make_shared<ServerClient>();
+        client->fd = fd;
+        std::string pending;
+        char buf[4096];
+        for (;;) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            pending.append(buf, (size_t)n);
+            for (size_t nl; (nl = pending.find('\n')) != std::string::npos;) {
+                submit(client, pending.substr(0, nl));
+                pending.erase(0, nl + 1);
+            }
+        }
+        if (!pending.empty()) submit(client, pending);
+    }
+#endif
+};
+
+static int run_server(const char *socketPath) {
+    unsigned workerCount = 4;
+    if (const char *env = std::getenv("SH3_SERVER_WORKERS")) {
+        int n = std::atoi(env);
+        if (n > 0) workerCount = (unsigned)n;
+    }
+    // Map the indexes before the first request instead of during it.
+    advance_index(RngBackend::PS2);
+    advance_index(RngBackend::PC);
+
+    if (!socketPath) {
+        QueryServer server(workerCount);
+        auto client = std::make_shared<ServerClient>();
+        std::string line;
+        while (std::getline(std::cin, line)) server.submit(client, line);
+        server.shutdown();
+        return 0;
+    }
+
+#if defined(SH3_HAVE_SOCKETS)
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(socketPath) >= sizeof(addr.sun_path)) {
+        std::cout << "Socket path too long: " << socketPath << "\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, socketPath);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // Clears a socket left by an earlier run; anything else at the path
+    // stays, and bind reports it.
+    struct stat existing;
+    if (lstat(socketPath, &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(socketPath);
+    if (listenFd < 0 || bind(listenFd, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0) {
+        std::cout << "Cannot listen on " << socketPath << ": " << std::strerror(errno) << "\n";
+        if (listenFd >= 0) close(listenFd);
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << socketPath << std::endl;
+
+    QueryServer server(workerCount);
+    for (;;) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cout << "accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        std::thread([&server, fd]() { server.serve_client(fd); }).detach();
+    }
+    close(listenFd);
+    server.shutdown();
+    return 1;
+#else
+    std::cout << "Unix sockets are not available here; run --serve without a path for stdin/stdout.\n";
+    return 1;
+#endif
+}
+
+// seedhill3 --bench [--window N] [--repeats R] [--baseline file] [--threshold pct]
+// Times the generators, the puzzle decoders and the reverse searches of
+// modes 4, 6, 7, 9, 11 and 12 on both backends, keeping the best of R runs
+// (default 3). Steps, decoders and scans each cover N advances (default
+// 10M), starting from seed 0. The result is one JSON object on stdout.
+// With --baseline, every benchmark found in an earlier output is compared
+// against this run. Any benchmark slower by more than the threshold
+// (default 10%) is flagged as a regression, and the exit code becomes 2.
+// A baseline that cannot be opened or holds no results exits with 1.
+// Code searches use an advance index when SH3_INDEX_PS2 / SH3_INDEX_PC is
+// set ("indexed" says so). Unset those variables to time the scanners.
+struct BenchResult {
+    std::string name;
+    const char *backend;
+    const char *unit;
+    double value;           // higher is better
+    bool indexed;
+};
+
+static volatile uint32_t bench_sink;
+
+template <typename Fn>
+static double bench_best_seconds(int repeats, Fn fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        best = std::min(best, took.count());
+    }
+    return std::max(best, 1e-9);
+}
+
+// Reads (name, backend) -> value back from a previous --bench output.
+// False if the file cannot be read.
+static bool bench_load_baseline(const std::string &path, std::map<std::string, double> &out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    auto field = [&](size_t from, size_t to, const std::string &key) -> std::string {
+        size_t at = text.find("\"" + key + "\":", from);
+        if (at == std::string::npos || at >= to) return "";
+        at += key.size() + 3;
+        if (text[at] == '"') return text.substr(at + 1, text.find('"', at + 1) - at - 1);
+        return text.substr(at, text.find_first_of(",}", at) - at);
+    };
+    const size_t results = text.find("\"results\":");
+    if (results == std::string::npos) return true;
+    for (size_t at = text.find('{', results); at != std::string::npos; at = text.find('{', at + 1)) {
+        size_t end = text.find('}', at);
+        if (end == std::string::npos) break;
+        std::string name = field(at, end, "name"), backend = field(at, end, "backend"), value = field(at, end, "value");
+        if (!name.empty() && !value.empty()) out[name + "/" + backend] = std::strtod(value.c_str(), nullptr);
+        at = end;
+    }
+    return true;
+}
+
+static int run_bench(int argc, char **argv) {
+    int64_t window = 10'000'000;
+    int repeats = 3;
+    std::string baselinePath;
+    double threshold = 10.0;
+    for (int i = 2; i < argc; i += 2) {
+        const std::string flag = (i + 1 < argc) ? argv[i] : "";
+        if (flag == "--window") window = std::max<int64_t>(std::strtoll(argv[i + 1], nullptr, 10), 1);
+        else if (flag == "--repeats") repeats = std::max(std::atoi(argv[i + 1]), 1);
+        else if (flag == "--baseline") baselinePath = argv[i + 1];
+        else if (flag == "--threshold") threshold = std::strtod(argv[i + 1], nullptr);
+        else {
+            // Unknown flags and a last flag missing its value.
+            std::cout << "Usage: " << argv[0]
+                      << " --bench [--window N] [--repeats R] [--baseline file] [--threshold pct]\n";
+            return 1;
+        }
     }
 
-    for (int adv = minAdvances; adv <= hardMaxAdvances; ++adv) {
-        uint32_t code = gen_shakespeare_code_from_seed(seedWarm, backend);
-        if (code == targetCodePacked) {
-            out.push_back({adv, seedWarm, code});
-            if ((int)out.size() >= maxResults) break;
+    // Checked before timing anything, so a mistyped path fails fast.
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty()) {
+        if (!bench_load_baseline(baselinePath, baseline)) {
+            std::cout << "Cannot open baseline " << baselinePath << "\n";
+            return 1;
+        }
+        if (baseline.empty()) {
+            std::cout << "Baseline " << baselinePath << " has no results\n";
+            return 1;
         }
-        rng_next31(seedWarm, backend);
     }
 
-    return out;
-}
+    std::vector<BenchResult> results;
+    for (RngBackend backend : {RngBackend::PS2, RngBackend::PC}) {
+        const char *bname = (backend == RngBackend::PS2) ? "ps2" : "pc";
+        const bool indexed = advance_index(backend) && advance_index(backend)->header.baseSeed == 0;
+        auto rate = [&](const char *name, const char *unit, double count, bool usesIndex, auto fn) {
+            results.push_back({name, bname, unit, count / bench_best_seconds(repeats, fn), usesIndex});
+        };
+        // Walks `window` consecutive states from seed 0 through `decode`.
+        auto decoder = [&](auto decode) {
+            return [&, decode]() {
+                uint32_t seed = 0, acc = 0;
+                for (int64_t i = 0; i < window; ++i) {
+                    acc ^= decode(seed);
+                    rng_next31(seed, backend);
+                }
+                bench_sink = acc;
+            };
+        };
+
+        rate("rand31", "advances/s", (double)window, false, [&]() {
+            uint32_t seed = 0, acc = 0;
+            if (backend == RngBackend::PS2) for (int64_t i = 0; i < window; ++i) acc ^= ps2_rand32_step(seed);
+            else                            for (int64_t i = 0; i < window; ++i) acc ^= pc_rand31_from_three(seed);
+            bench_sink = acc;
+        });
+        rate("rng_advance", "jumps/s", 1e6, false, [&]() {
+            uint32_t seed = 0;
+            for (uint64_t i = 0; i < 1'000'000; ++i) rng_advance(seed, backend, i * 0x9E3779B9u);
+            bench_sink = seed;
+        });
+
+        rate("decode_shakespeare", "decodes/s", (double)window, false,
+             decoder([&](uint32_t s) { return gen_shakespeare_code_from_seed(s, backend); }));
+        rate("decode_hospital3f", "decodes/s", (double)window, false,
+             decoder([&](uint32_t s) { return gen_hospital3f_code_from_seed(s, backend); }));
+        rate("decode_crematorium", "decodes/s", (double)window, false,
+             decoder([&](uint32_t s) { return gen_crematorium_meta_from_seed(s, backend).codePacked; }));
+        rate("decode_clock", "decodes/s", (double)window, false,
+             decoder([&](uint32_t s) { return gen_clock_puzzle(s, 0, 0, backend, false); }));
+
+        // Reverse searches keep every match so none stops early.
+        rate("mode4_shakespeare", "advances/s", (double)window, indexed, [&]() {
+            bench_sink = (uint32_t)find_shakespeare_seeds_for_code(0, 0x1234, INT32_MAX, backend, 0, window).size();
+        });
+        rate("mode6_clock_hour", "advances/s", (double)window, false, [&]() {
+            bench_sink = (uint32_t)find_clock_warmups_flexible(0, 0, backend, true, false, 3, 0, 0, window,
+                                                               INT32_MAX).size();
+        });
+        rate("mode7_clock_time", "advances/s", (double)window, false, [&]() {
+            bench_sink = (uint32_t)find_clock_warmups(0, 0, 3, 7, backend, 0, window, INT32_MAX).size();
+        });
+        rate("mode9_hospital3f", "advances/s", (double)window, indexed, [&]() {
+            bench_sink = (uint32_t)find_hospital3f_seeds_for_code(0, 0x1234, INT32_MAX, backend, 0, window).size();
+        });
+        rate("mode11_crematorium", "advances/s", (double)window, indexed, [&]() {
+            bench_sink = (uint32_t)find_crematorium_seeds_for_code(0, 0x7360, INT32_MAX, backend, 0, window).size();
+        });
+        rate("mode12_distance", "queries/s", 1e4, false, [&]() {
+            uint32_t target = 0x12345678u, acc = 0;
+            for (int i = 0; i < 10'000; ++i) {
+                target = target * 0x9E3779B1u + 1u;
+                uint32_t t = (backend == RngBackend::PS2) ? (target & 0x7FFFFFFFu) : target;
+                acc += (uint32_t)find_seed_distance(0, t, backend).value_or(0);
+            }
+            bench_sink = acc;
+        });
+    }
 
-static void print_shakespeare(uint32_t code) {
-    std::cout << "\nShakespeare 4-digit code = 0x"
-              << std::hex << std::uppercase << code << std::dec
-              << " (digits packed as nibbles)\n";
-    std::cout << "Digits shown as decimal: "
-              << ((code >> 12) & 0xF)
-              << ((code >> 8)  & 0xF)
-              << ((code >> 4)  & 0xF)
-              << (code & 0xF) << "\n";
+    bool regressed = false;
+    std::cout << "{\"window\":" << window << ",\"repeats\":" << repeats
+              << ",\"threads\":" << scan_thread_count() << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        std::cout << (i ? "," : "") << "\n  {\"name\":" << json_string(r.name)
+                  << ",\"backend\":" << json_string(r.backend) << ",\"unit\":" << json_string(r.unit)
+                  << ",\"value\":" << std::fixed << std::setprecision(0) << r.value
+                  << ",\"indexed\":" << (r.indexed ? "true" : "false");
+        auto base = baseline.find(r.name + "/" + r.backend);
+        if (base != baseline.end() && base->second > 0) {
+            const double change = (r.value - base->second) / base->second * 100.0;
+            const bool regression = change < -threshold;
+            regressed |= regression;
+            std::cout << ",\"baseline\":" << base->second << ",\"changePct\":" << std::setprecision(1) << change
+                      << ",\"regression\":" << (regression ? "true" : "false");
+        }
+        std::cout << "}";
+    }
+    std::cout << "\n]";
+    if (!baselinePath.empty()) {
+        std::cout << ",\"baseline\":" << json_string(baselinePath) << ",\"thresholdPct\":" << std::setprecision(1)
+                  << threshold << ",\"regressed\":" << (regressed ? "true" : "false");
+    }
+    std::cout << "}" << std::endl;
+    return regressed ? 2 : 0;
 }
 
-static void print_clock(uint32_t packed) {
-    int h_tens = (packed >> 12) & 0xF;
-    int h_ones = (packed >> 8)  & 0xF;
-    int m_tens = (packed >> 4)  & 0xF;
-    int m_ones = (packed)       & 0xF;
+// seedhill3 --build-index <p|c> <horizon> <output> [baseSeedHex]
+// horizon is a decimal advance count or a power of two written 2^N.
+static int run_build_index(int argc, char **argv) {
+    if (argc < 5) {
+        std::cout << "Usage: " << argv[0] << " --build-index <p|c> <horizon> <output> [baseSeedHex]\n"
+                  << "  Indexes advances [0, horizon) of the stream from baseSeed (default 0).\n"
+                  << "  Point SH3_INDEX_PS2 / SH3_INDEX_PC at the output to use it in modes 4, 9 and 11.\n";
+        return 1;
+    }
+    const char rngInput = argv[2][0];
+    RngBackend backend = (rngInput == 'c' || rngInput == 'C') ? RngBackend::PC : RngBackend::PS2;
 
-    int hour = h_tens * 10 + h_ones;
-    int minute = m_tens * 10 + m_ones;
+    const std::string horizonText = argv[3];
+    uint64_t horizon = 0;
+    if (horizonText.rfind("2^", 0) == 0) {
+        int bits = std::atoi(horizonText.c_str() + 2);
+        if (bits >= 0 && bits < 64) horizon = uint64_t(1) << bits;
+    } else {
+        horizon = std::strtoull(horizonText.c_str(), nullptr, 10);
+    }
+    if (horizon == 0 || horizon > INDEX_MAX_HORIZON) {
+        std::cout << "Horizon must be between 1 and 2^40 advances.\n";
+        return 1;
+    }
 
-    std::cout << "\nClock puzzle packed = 0x"
-              << std::hex << std::uppercase << packed << std::dec << "\n";
-    std::cout << "Decoded time = "
-              << hour << ":"
-              << (minute < 10 ? "0" : "") << minute << "\n";
-    std::cout << "Digits: " << h_tens << h_ones << m_tens << m_ones << "\n";
+    uint32_t baseSeed = (argc > 5) ? (uint32_t)std::strtoul(argv[5], nullptr, 16) : 0u;
+    if ((baseSeed & rng_state_mask(backend)) != baseSeed) {
+        std::cout << "Base seed is not a valid state for this backend (PS2 seeds are 31-bit).\n";
+        return 1;
+    }
+    return build_advance_index(argv[4], backend, baseSeed, horizon) ? 0 : 1;
 }
 
-struct HospitalMatch {
-    int advances;
-    uint32_t seedAfterWarmup;
-    uint32_t codePacked;
-};
-
-uint32_t gen_hospital3f_code(uint32_t seed, int warmupAfterReset, RngBackend backend, bool verbose=false);
-static void print_hospital3f(uint32_t code);
-static std::optional<uint32_t> parse_hospital3f_code_input(const std::string& s);
-
-static std::vector<HospitalMatch> find_hospital3f_seeds_for_code(
-    uint32_t startSeed,
-    uint32_t targetCodePacked,
-    int maxResults,
-    RngBackend backend,
-    int minAdvances,
-    int maxAdvances
-);
+// Reads an advance bound. "full" means the last advance of the backend's
+// period, so the scan visits every state once.
+static int64_t read_max_advances(RngBackend backend) {
+    std::string text;
+    std::cin >> text;
+    if (text == "full" || text == "f" || text == "F") return (int64_t)rng_period(backend) - 1;
+    return std::strtoll(text.c_str(), nullptr, 10);
+}
 
-struct CrematoriumMatch {
-    int advances;
-    uint32_t seedAfterWarmup;
-    uint32_t codePacked;
-    bool forced7;
-    int forcedPosLSB; 
-};
+// Modes 4, 9 and 11 with a comma-separated code list or a pattern: the
+// rest of the prompts for a multi-target search, then the matches in
+// order. A list has a quota per code; a pattern stands for however many
+// codes fit it, so its quota is for all of them together.
+template <typename ParseFn>
+static int run_code_set_search(IndexPuzzle puzzle, const std::string &codeList, ParseFn parse, RngBackend backend) {
+    std::vector<CodeSetGroup> groups;
+    if (!parse_code_list(codeList, puzzle, parse, groups)) {
+        std::cout << "Invalid code list or pattern. Separate codes with commas and no spaces (e.g. 0123,4567);\n"
+                     "a pattern has 4 positions of digit, ? or [digits] like 7?2? or [13]??? then any +digit.\n";
+        return 0;
+    }
+    std::cout << "Enter starting seed to scan from (hex, no 0x): ";
+    uint32_t startSeed = 0;
+    std::cin >> std::hex >> startSeed;
+    std::cin >> std::dec;
+
+    int64_t minAdvances = 0;
+    std::cout << "Min advances to start searching from (decimal, e.g. 0): ";
+    std::cin >> minAdvances;
+    if (minAdvances < 0) minAdvances = 0;
+
+    std::cout << "Max advances to search up to (decimal, e.g. 5000000, or full): ";
+    int64_t maxAdvances = read_max_advances(backend);
+    if (maxAdvances < minAdvances) maxAdvances = minAdvances;
+
+    int maxResults = 0;
+    std::cout << "Max matches to show per code or pattern (decimal, e.g. 5): ";
+    std::cin >> maxResults;
+    if (maxResults <= 0) {
+        std::cout << "Max results must be > 0.\n";
+        return 0;
+    }
+    for (CodeSetGroup &group : groups) group.quota = maxResults;
 
-uint32_t gen_crematorium_code_guarantee7(uint32_t seed, int warmupAfterReset, RngBackend backend, bool verbose=false);
-static void print_crematorium(uint32_t code, bool forced7, int forcedPosLSB);
-static std::optional<uint32_t> parse_crematorium_code_input(const std::string& s);
+    auto matches = find_code_set_matches(puzzle, groups, startSeed, backend, minAdvances, maxAdvances);
+    if (matches.empty()) {
+        std::cout << "\nNo matches found in [" << minAdvances << ".." << maxAdvances
+                  << "] advances from start seed 0x" << std::hex << std::uppercase << startSeed << std::dec << ".\n";
+        return 0;
+    }
+    print_code_set_matches(matches, startSeed);
+    return 0;
+}
 
-static std::vector<CrematoriumMatch> find_crematorium_seeds_for_code(
-    uint32_t startSeed,
-    uint32_t targetCodePacked,
-    int maxResults,
-    RngBackend backend,
-    int minAdvances,
-    int maxAdvances
-);
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "--build-index") return run_build_index(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--batch") return run_batch(argc > 2 ? argv[2] : "-");
+    if (argc > 1 && std::string(argv[1]) == "--bench") return run_bench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--serve") return run_server(argc > 2 ? argv[2] : nullptr);
+    scan_progress = true;
+    // With SH3_STATS set, the query's counters follow its output.
+    QueryStatsScope statsScope(&std::cout);
 
-int main() {
     std::cout << "Silent Hill 3 RNG tool\n";
     std::cout << "Choose input mode:\n";
     std::cout << "  1) Shakespeare Puzzle: Enter base seed + warmup count directly\n";
@@ -493,7 +4104,13 @@ int main() {
     std::cout << "  10) Crematorium Oven: Generate 4-digit code from seed/warmups\n";
     std::cout << "  11) Crematorium Oven: Reverse (enter 4-digit code -> list possible seeds + forced7)\n";
     std::cout << "  12) RNG: Continuous warmup distances (base -> target1 -> target2 ...)\n";
-    std::cout << "Mode (1/2/3/4/5/6/7/8/9/10/11/12): ";
+    std::cout << "  13) Route: Chain of puzzles a known number of advances apart -> list base advances\n";
+    std::cout << "  14) Route: Two observed puzzles with an unknown gap -> list position pairs\n";
+    std::cout << "  15) Timeline: Every puzzle's outcome at each advance of a window, or code histograms\n";
+    std::cout << "  16) RNG: Recover the PC state from observed rand() returns -> list seeds + distance from 0\n";
+    std::cout << "  17) Route: Observed puzzles with known offsets, no base seed -> every matching state\n";
+    std::cout << "  18) Clock puzzle: Target HH:MM + warmup -> list base seeds, a page at a time (PS2)\n";
+    std::cout << "Mode (1/2/3/4/5/6/7/8/9/10/11/12/13/14/15/16/17/18): ";
 
     int mode = 1;
     std::cin >> mode;
@@ -503,7 +4120,7 @@ int main() {
     std::cin >> rngInput;
     RngBackend backend = (rngInput == 'c' || rngInput == 'C') ? RngBackend::PC : RngBackend::PS2;
 
-    int warmup = 0;
+    int64_t warmup = 0;
     uint32_t baseSeed = 0u;
 
     if (mode == 2) {
@@ -521,7 +4138,7 @@ int main() {
             std::cout << "Warmup not found in search range.\n";
             return 0;
         }
-        warmup = *w;
+        warmup = (int64_t)*w;
         std::cout << "Auto-found warmup = " << warmup << "\n\n";
 
         uint32_t code = gen_shakespeare_code(baseSeed, warmup, backend, true);
@@ -600,13 +4217,12 @@ int main() {
             modeByte = (modeInput == 'y' || modeInput == 'Y') ? 2 : 0;
         }
 
-        int minWarmup;
+        int64_t minWarmup;
         std::cout << "Min advances to start searching from (decimal, e.g. 0): ";
         std::cin >> minWarmup;
 
-        int maxWarmup;
-        std::cout << "Max advances to search up to (decimal, e.g. 500000): ";
-        std::cin >> maxWarmup;
+        std::cout << "Max advances to search up to (decimal, e.g. 500000, or full): ";
+        int64_t maxWarmup = read_max_advances(backend);
 
         int maxResults;
         std::cout << "Max matches to show (decimal, e.g. 20): ";
@@ -685,13 +4301,12 @@ int main() {
         std::cin >> modeInput;
         uint8_t modeByte = (modeInput == 'y' || modeInput == 'Y') ? 2 : 0;
 
-        int minWarmup;
+        int64_t minWarmup;
         std::cout << "Min warmup to start searching from (decimal, e.g. 0): ";
         std::cin >> minWarmup;
 
-        int maxWarmup;
-        std::cout << "Max warmup to search up to (decimal, e.g. 5000): ";
-        std::cin >> maxWarmup;
+        std::cout << "Max warmup to search up to (decimal, e.g. 5000, or full): ";
+        int64_t maxWarmup = read_max_advances(backend);
 
         int maxResults;
         std::cout << "Max matches to show (decimal, e.g. 20): ";
@@ -720,8 +4335,6 @@ int main() {
         std::cin >> std::hex >> baseSeed;
         std::cin >> std::dec;
 
-        constexpr int maxSteps = 10000000;
-
         uint32_t currentSeed = baseSeed;
         uint64_t totalAdvances = 0;
 
@@ -736,24 +4349,282 @@ int main() {
                 break;
             }
 
-            auto dist = find_seed_distance(currentSeed, targetSeed, backend, maxSteps);
+            auto dist = find_seed_distance(currentSeed, targetSeed, backend);
             if (!dist) {
-                std::cout << "Target seed not found within " << maxSteps << " advances from current seed.\n";
-                std::cout << "(This likely means a reseed/overwrite occurred, or maxSteps is too small.)\n";
+                std::cout << "Target seed is not a valid state for this backend (PS2 seeds are 31-bit).\n";
+                std::cout << "(This likely means the value was mistyped or a reseed/overwrite occurred.)\n";
             } else {
                 std::cout << "Advances from 0x" << std::hex << std::uppercase << currentSeed << std::dec
                           << " -> 0x" << std::hex << std::uppercase << targetSeed << std::dec
                           << " = " << *dist << "\n";
-                totalAdvances += (uint64_t)(*dist);
+                totalAdvances += *dist;
                 currentSeed = targetSeed;
             }
         }
         return 0;
 
+    } else if (mode == 13) {
+        std::vector<RouteStep> steps;
+        if (!read_route_steps(steps)) return 0;
+
+        uint32_t startSeed = 0;
+        std::cout << "\nEnter base seed (hex, no 0x). For new-game stream use 0: ";
+        std::cin >> std::hex >> startSeed;
+        std::cin >> std::dec;
+
+        int64_t minBase = 0;
+        std::cout << "Min base advance (first puzzle) to search from (decimal, e.g. 0): ";
+        std::cin >> minBase;
+        if (minBase < 0) minBase = 0;
+
+        std::cout << "Max base advance to search up to (decimal, e.g. 1000000000, or full): ";
+        int64_t maxBase = read_max_advances(backend);
+        if (maxBase < minBase) maxBase = minBase;
+
+        int maxResults = 0;
+        std::cout << "Max matches to show (decimal, e.g. 20): ";
+        std::cin >> maxResults;
+        if (maxResults <= 0) {
+            std::cout << "Max results must be > 0.\n";
+            return 0;
+        }
+
+        auto matches = find_route_matches(startSeed, backend, steps, minBase, maxBase, maxResults);
+        if (matches.empty()) {
+            std::cout << "\nNo base advance in [" << minBase << ".." << maxBase << "] satisfies the route.\n";
+            return 0;
+        }
+        print_route_matches(steps, matches, startSeed, backend);
+        return 0;
+
+    } else if (mode == 14) {
+        RouteStep first{RoutePuzzle::Shakespeare, true, 0u, 0, 0, 0};
+        RouteStep second = first;
+        if (!read_route_puzzle("First observation", first)) return 0;
+        if (!read_route_puzzle("Second observation", second)) return 0;
+
+        int64_t gapMin = 0, gapMax = 0;
+        std::cout << "Advances from first to second observation (min): ";
+        std::cin >> gapMin;
+        std::cout << "Advances from first to second observation (max): ";
+        std::cin >> gapMax;
+        if (gapMin < 0 || gapMax < gapMin) {
+            std::cout << "Gap must satisfy 0 <= min <= max.\n";
+            return 0;
+        }
+
+        uint32_t startSeed = 0;
+        std::cout << "\nEnter base seed (hex, no 0x). For new-game stream use 0: ";
+        std::cin >> std::hex >> startSeed;
+        std::cin >> std::dec;
+
+        int64_t minFirst = 0;
+        std::cout << "Min advances of the first observation (decimal, e.g. 0): ";
+        std::cin >> minFirst;
+        if (minFirst < 0) minFirst = 0;
+
+        std::cout << "Max advances of the first observation (decimal, e.g. 10000000, or full): ";
+        int64_t maxFirst = read_max_advances(backend);
+        if (maxFirst < minFirst) maxFirst = minFirst;
+
+        int maxResults = 0;
+        std::cout << "Max pairs to show (decimal, e.g. 20): ";
+        std::cin >> maxResults;
+        if (maxResults <= 0) {
+            std::cout << "Max results must be > 0.\n";
+            return 0;
+        }
+
+        auto pairs = find_gap_pairs(startSeed, backend, first, second, minFirst, maxFirst, gapMin, gapMax, maxResults);
+        if (pairs.empty()) {
+            std::cout << "\nNo pair with the first observation in [" << minFirst << ".." << maxFirst
+                      << "] and a gap in [" << gapMin << ".." << gapMax << "].\n";
+            return 0;
+        }
+
+        std::cout << "\nPairs from seed 0x" << std::hex << std::uppercase << startSeed << std::dec
+                  << " (each advance = 1 rand call):\n";
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            const GapPair &pair = pairs[i];
+            std::cout << "  [" << i << "] gap=" << (pair.second.adv - pair.first.adv) << "\n      ";
+            print_route_hit(first, pair.first.adv, pair.first.seed, backend);
+            std::cout << "\n      ";
+            print_route_hit(second, pair.second.adv, pair.second.seed, backend);
+            std::cout << "\n";
+        }
+        return 0;
+
+    } else if (mode == 15) {
+        uint32_t startSeed = 0;
+        std::cout << "Enter base seed (hex, no 0x). For new-game stream use 0: ";
+        std::cin >> std::hex >> startSeed;
+        std::cin >> std::dec;
+
+        int64_t minAdvances = 0;
+        std::cout << "Min advances (decimal, e.g. 0): ";
+        std::cin >> minAdvances;
+        if (minAdvances < 0) minAdvances = 0;
+
+        std::cout << "Max advances (decimal, e.g. 1000, or full): ";
+        int64_t maxAdvances = read_max_advances(backend);
+        if (maxAdvances < minAdvances) maxAdvances = minAdvances;
+
+        char output;
+        std::cout << "Output: (t)imeline per advance or (h)istogram per puzzle: ";
+        std::cin >> output;
+
+        if (output == 'h' || output == 'H') {
+            int top = 0;
+            std::cout << "Outcomes to list per puzzle, most frequent first (decimal, 0 = all): ";
+            std::cin >> top;
+
+            TimelineHistogram h = find_timeline_histogram(startSeed, backend, minAdvances, maxAdvances);
+            std::cout << "\nHistograms over advances [" << minAdvances << ".." << maxAdvances << "] from seed 0x"
+                      << std::hex << std::uppercase << startSeed << std::dec << " (" << h.advances << " advances):\n";
+            print_timeline_histogram(h, (size_t)std::max(top, 0));
+            return 0;
+        }
+
+        std::cout << "\n   advance  seed      shk   h3f   crem    12h    24h\n";
+        std::cout << "  (crem *N: the 7 was forced into nibble N, counted from the right)\n";
+        find_timeline(startSeed, backend, minAdvances, maxAdvances, [](const std::vector<TimelineEntry> &entries) {
+            for (const TimelineEntry &e : entries) print_timeline_entry(e);
+        });
+        return 0;
+
+    } else if (mode == 18) {
+        if (backend == RngBackend::PC) {
+            std::cout << "On PC a rand() return is not the state, so base seeds cannot be listed this way; use mode 7.\n";
+            return 0;
+        }
+
+        std::cout << "Enter target hour (decimal): ";
+        int targetHour; std::cin >> targetHour;
+        std::cout << "Enter target minute (decimal 0-59): ";
+        int targetMinute; std::cin >> targetMinute;
+
+        char modeInput;
+        std::cout << "24h path option (y/n): ";
+        std::cin >> modeInput;
+        uint8_t modeByte = (modeInput == 'y' || modeInput == 'Y') ? 2 : 0;
+
+        int64_t warmupAfterReset;
+        std::cout << "Warmup between the base seed and the clock puzzle (decimal): ";
+        std::cin >> warmupAfterReset;
+        if (warmupAfterReset < 0) {
+            std::cout << "Warmup must be >= 0.\n";
+            return 0;
+        }
+
+        int pageSize = 0;
+        std::cout << "Base seeds per page (decimal, e.g. 200): ";
+        std::cin >> pageSize;
+        if (pageSize <= 0) {
+            std::cout << "Page size must be > 0.\n";
+            return 0;
+        }
+
+        ClockSeedCursor cursor;
+        size_t shown = 0;
+        for (;;) {
+            auto seeds = find_clock_base_seeds(targetHour, targetMinute, modeByte, warmupAfterReset, pageSize, &cursor);
+            if (shown == 0 && seeds.empty()) {
+                std::cout << "\nNo base seed shows " << targetHour << ":" << (targetMinute<10?"0":"") << targetMinute
+                          << " on that path.\n";
+                return 0;
+            }
+            if (shown == 0) {
+                std::cout << "\nBase seeds for " << targetHour << ":" << (targetMinute<10?"0":"") << targetMinute
+                          << " after " << warmupAfterReset << " warmup:\n";
+            }
+            for (uint32_t seed : seeds) {
+                std::cout << "  [" << shown++ << "] seed=0x" << std::hex << std::uppercase << seed << std::dec << "\n";
+            }
+            if (cursor.done) {
+                std::cout << "All " << shown << " base seeds listed.\n";
+                return 0;
+            }
+            char more;
+            std::cout << "More? (y/n): ";
+            if (!(std::cin >> more) || (more != 'y' && more != 'Y')) return 0;
+        }
+
+    } else if (mode == 17) {
+        std::vector<RouteStep> steps;
+        if (!read_route_steps(steps)) return 0;
+
+        int maxResults = 0;
+        std::cout << "\nMax matches to show (decimal, e.g. 20): ";
+        std::cin >> maxResults;
+        if (maxResults <= 0) {
+            std::cout << "Max results must be > 0.\n";
+            return 0;
+        }
+
+        std::cout << "Searching all " << rng_period(backend) << " states...\n";
+        auto matches = find_global_route_states(backend, steps, maxResults);
+        if (matches.empty()) {
+            std::cout << "\nNo state in the whole period satisfies the route.\n";
+            return 0;
+        }
+        print_route_matches(steps, matches, 0u, backend);
+        return 0;
+
+    } else if (mode == 16) {
+        if (backend == RngBackend::PS2) {
+            std::cout << "On PS2 the rand() return is the state itself; use mode 12 for its distance from 0.\n";
+            return 0;
+        }
+
+        char kind;
+        std::cout << "Observed values are (f)ull rand() returns (31-bit) or single (r)and15 draws (15-bit)? (f/r): ";
+        std::cin >> kind;
+        const bool rand15 = (kind == 'r' || kind == 'R');
+
+        int count = 0;
+        std::cout << "How many consecutive values (decimal, 2 usually pin the state): ";
+        std::cin >> count;
+        if (count <= 0) {
+            std::cout << "Need at least one value.\n";
+            return 0;
+        }
+
+        std::vector<uint32_t> observed((size_t)count);
+        for (int i = 0; i < count; ++i) {
+            std::cout << "Value " << (i + 1) << " (hex, no 0x): ";
+            std::cin >> std::hex >> observed[(size_t)i];
+            std::cin >> std::dec;
+        }
+
+        std::vector<PcDrawConstraint> checks = pc_draw_constraints(observed, rand15);
+        if (checks.empty()) {
+            std::cout << "Value out of range (rand() returns are at most 0x7FFFFFFF, rand15 draws 0x7FFF).\n";
+            return 0;
+        }
+        auto states = recover_pc_states(checks);
+        if (states.empty()) {
+            std::cout << "\nNo PC state produces these values in a row.\n";
+            return 0;
+        }
+
+        std::cout << "\nStates before the first observed value (" << states.size() << " candidate"
+                  << (states.size() == 1 ? "" : "s") << "; bit 31 never shows in a rand() return, so they come in pairs):\n";
+        for (size_t i = 0; i < states.size(); ++i) {
+            const PcRecoveredState &r = states[i];
+            std::cout << "  [" << i << "] myseed=0x" << std::hex << std::uppercase << r.myseed << std::dec
+                      << "  advances from seed 0=" << r.advancesFromZero
+                      << "  (rand15 steps=" << r.stepsFromZero << ")\n";
+        }
+        return 0;
+
     } else if (mode == 4) {
-        std::cout << "Enter target Shakespeare code (either 4 digits like 0123, or packed hex like 0x0123): ";
+        std::cout << "Enter target Shakespeare code (either 4 digits like 0123, or packed hex like 0x0123;\n"
+                     "several separated by commas, or patterns like 7?2?, [13]??? and ????+5, search for all at once): ";
         std::string codeStr;
         std::cin >> codeStr;
+        if (codeStr.find(',') != std::string::npos || is_code_pattern(codeStr)) {
+            return run_code_set_search(IndexPuzzle::Shakespeare, codeStr, parse_shakespeare_code_input, backend);
+        }
 
         auto parsed = parse_shakespeare_code_input(codeStr);
         if (!parsed) {
@@ -767,14 +4638,13 @@ int main() {
         std::cin >> std::hex >> startSeed;
         std::cin >> std::dec;
 
-        int minAdvances = 0;
+        int64_t minAdvances = 0;
         std::cout << "Min advances to start searching from (decimal, e.g. 0): ";
         std::cin >> minAdvances;
         if (minAdvances < 0) minAdvances = 0;
 
-        int hardMaxAdvances = 0;
-        std::cout << "Max advances to search up to (decimal, e.g. 5000000): ";
-        std::cin >> hardMaxAdvances;
+        std::cout << "Max advances to search up to (decimal, e.g. 5000000, or full): ";
+        int64_t hardMaxAdvances = read_max_advances(backend);
         if (hardMaxAdvances < minAdvances) hardMaxAdvances = minAdvances;
 
         int maxResults = 0;
@@ -824,9 +4694,13 @@ int main() {
         return 0;
 
     } else if (mode == 9) {
-        std::cout << "Enter target 3F Hospital code (either 4 digits like 2580, or packed hex like 0x2580): ";
+        std::cout << "Enter target 3F Hospital code (either 4 digits like 2580, or packed hex like 0x2580;\n"
+                     "several separated by commas, or patterns like 7?2?, [13]??? and ????+5, search for all at once): ";
         std::string codeStr;
         std::cin >> codeStr;
+        if (codeStr.find(',') != std::string::npos || is_code_pattern(codeStr)) {
+            return run_code_set_search(IndexPuzzle::Hospital3F, codeStr, parse_hospital3f_code_input, backend);
+        }
 
         auto parsed = parse_hospital3f_code_input(codeStr);
         if (!parsed) {
@@ -840,14 +4714,13 @@ int main() {
         std::cin >> std::hex >> startSeed;
         std::cin >> std::dec;
 
-        int minAdvances = 0;
+        int64_t minAdvances = 0;
         std::cout << "Min advances to start searching from (decimal, e.g. 0): ";
         std::cin >> minAdvances;
         if (minAdvances < 0) minAdvances = 0;
 
-        int maxAdvances = 0;
-        std::cout << "Max advances to search up to (decimal, e.g. 5000000): ";
-        std::cin >> maxAdvances;
+        std::cout << "Max advances to search up to (decimal, e.g. 5000000, or full): ";
+        int64_t maxAdvances = read_max_advances(backend);
         if (maxAdvances < minAdvances) maxAdvances = minAdvances;
 
         int maxResults = 0;
@@ -892,43 +4765,23 @@ int main() {
 
         std::cout << "\n";
 
-        uint32_t seedTmp = baseSeed;
-        rng_advance(seedTmp, backend, warmup);
-        bool forced7 = false;
-        int forcedPos = -1;
-
         uint32_t code = gen_crematorium_code_guarantee7(baseSeed, warmup, backend, true);
 
-        {
-            uint32_t s = baseSeed;
-            rng_advance(s, backend, warmup);
-            std::array<int,10> pool = {0,1,2,3,4,5,6,7,8,9};
-            int poolSize = 10;
-            uint32_t packed = 0;
-            bool saw7 = false;
-            for (int i = 0; i < 4; ++i) {
-                uint32_t r = rng_next31(s, backend);
-                int idx = (int)(r % (uint32_t)poolSize);
-                int digit = pool[idx];
-                if (digit == 7) saw7 = true;
-                packed = (packed << 4) | (uint32_t)digit;
-                for (int j = idx; j < poolSize - 1; ++j) pool[j] = pool[j + 1];
-                poolSize--;
-            }
-            if (!saw7) {
-                uint32_t r = rng_next31(s, backend);
-                forcedPos = (int)(r % 4u);
-                forced7 = true;
-            }
-        }
+        uint32_t seedTmp = baseSeed;
+        rng_advance(seedTmp, backend, (uint64_t)std::max<int64_t>(warmup, 0));
+        CrematoriumMeta meta = gen_crematorium_meta_from_seed(seedTmp, backend);
 
-        print_crematorium(code, forced7, forcedPos);
+        print_crematorium(code, meta.forced7, meta.forcedPosLSB);
         return 0;
 
     } else if (mode == 11) {
-        std::cout << "Enter target Crematorium Oven code (either 4 digits like 7012, or packed hex like 0x7012): ";
+        std::cout << "Enter target Crematorium Oven code (either 4 digits like 7012, or packed hex like 0x7012;\n"
+                     "several separated by commas, or patterns like 7?2?, [13]??? and ????+5, search for all at once): ";
         std::string codeStr;
         std::cin >> codeStr;
+        if (codeStr.find(',') != std::string::npos || is_code_pattern(codeStr)) {
+            return run_code_set_search(IndexPuzzle::Crematorium, codeStr, parse_crematorium_code_input, backend);
+        }
 
         auto parsed = parse_crematorium_code_input(codeStr);
         if (!parsed) {
@@ -942,14 +4795,13 @@ int main() {
         std::cin >> std::hex >> startSeed;
         std::cin >> std::dec;
 
-        int minAdvances = 0;
+        int64_t minAdvances = 0;
         std::cout << "Min advances to start searching from (decimal, e.g. 0): ";
         std::cin >> minAdvances;
         if (minAdvances < 0) minAdvances = 0;
 
-        int maxAdvances = 0;
-        std::cout << "Max advances to search up to (decimal, e.g. 5000000): ";
-        std::cin >> maxAdvances;
+        std::cout << "Max advances to search up to (decimal, e.g. 5000000, or full): ";
+        int64_t maxAdvances = read_max_advances(backend);
         if (maxAdvances < minAdvances) maxAdvances = minAdvances;
 
         int maxResults = 0;
@@ -983,32 +4835,8 @@ int main() {
         }
 
         std::cout << "\nSanity-check first match:\n";
-        {
-            uint32_t s = matches.front().seedAfterWarmup;
-            bool forced7 = false;
-            int forcedPos = -1;
-            std::array<int,10> pool = {0,1,2,3,4,5,6,7,8,9};
-            int poolSize = 10;
-            uint32_t packed = 0;
-            bool saw7 = false;
-            for (int i = 0; i < 4; ++i) {
-                uint32_t r = rng_next31(s, backend);
-                int idx = (int)(r % (uint32_t)poolSize);
-                int digit = pool[idx];
-                if (digit == 7) saw7 = true;
-                packed = (packed << 4) | (uint32_t)digit;
-                for (int j = idx; j < poolSize - 1; ++j) pool[j] = pool[j + 1];
-                poolSize--;
-            }
-            if (!saw7) {
-                uint32_t r = rng_next31(s, backend);
-                forcedPos = (int)(r % 4u);
-                forced7 = true;
-                uint32_t shift = (uint32_t)(forcedPos * 4);
-                packed = (packed & ~(0xFu << shift)) | (7u << shift);
-            }
-            print_crematorium(packed, forced7, forcedPos);
-        }
+        CrematoriumMeta meta = gen_crematorium_meta_from_seed(matches.front().seedAfterWarmup, backend);
+        print_crematorium(meta.codePacked, meta.forced7, meta.forcedPosLSB);
 
         return 0;
     } else {
@@ -1026,32 +4854,28 @@ int main() {
     }
 }
 
-uint32_t gen_hospital3f_code(uint32_t seed, int warmupAfterReset, RngBackend backend, bool verbose) {
-    rng_advance(seed, backend, warmupAfterReset);
-
-    std::vector<int> pool{1,2,3,4,5,6,7,8,9};
-    uint32_t code4 = 0;
+uint32_t gen_hospital3f_code(uint32_t seed, int64_t warmupAfterReset, RngBackend backend, bool verbose) {
+    rng_advance(seed, backend, (uint64_t)std::max<int64_t>(warmupAfterReset, 0));
 
+    uint32_t r[4];
+    uint32_t tuple = 0;
     for (int i = 0; i < 4; ++i) {
-        int32_t r = static_cast<int32_t>(rng_next31(seed, backend));
-        int size = 9 - i;
-
-        int idx = r % size;
-        if (idx < 0) idx += size;
-
-        int digit = pool[idx];
-        code4 = (code4 << 4) | static_cast<uint32_t>(digit);
+        r[i] = rng_next31(seed, backend);
+        uint32_t size = 9u - (uint32_t)i;
+        tuple = tuple * size + r[i] % size;
+    }
+    uint32_t code4 = HOSPITAL3F_CODES[tuple];
 
-        if (verbose) {
+    if (verbose) {
+        for (int i = 0; i < 4; ++i) {
+            int size = 9 - i;
             std::cout << "rand#" << (i + 1)
-                      << " = 0x" << std::hex << std::uppercase << (uint32_t)r
+                      << " = 0x" << std::hex << std::uppercase << r[i]
                       << std::dec
                       << ", size=" << size
-                      << ", idx=" << idx
-                      << ", digit=" << digit << "\n";
+                      << ", idx=" << (r[i] % (uint32_t)size)
+                      << ", digit=" << ((code4 >> (12 - 4 * i)) & 0xF) << "\n";
         }
-
-        pool.erase(pool.begin() + idx);
     }
 
     return code4;
@@ -1125,23 +4949,7 @@ static std::optional<uint32_t> parse_hospital3f_code_input(const std::string& s)
 
 
 static inline uint32_t gen_hospital3f_code_from_seed(uint32_t seedAfterWarmup, RngBackend backend) {
-    std::array<int, 9> pool = {1,2,3,4,5,6,7,8,9};
-    int poolSize = 9;
-    uint32_t code4 = 0;
-
-    for (int i = 0; i < 4; ++i) {
-        int32_t r = (int32_t)rng_next31(seedAfterWarmup, backend);
-        int idx = r % poolSize;
-        if (idx < 0) idx += poolSize;
-
-        int digit = pool[idx];
-        code4 = (code4 << 4) | (uint32_t)digit;
-
-        for (int j = idx; j < poolSize - 1; ++j) pool[j] = pool[j + 1];
-        poolSize--;
-    }
-
-    return code4;
+    return HOSPITAL3F_CODES[draw_tuple<9>(seedAfterWarmup, backend)];
 }
 
 static std::vector<HospitalMatch> find_hospital3f_seeds_for_code(
@@ -1149,28 +4957,23 @@ static std::vector<HospitalMatch> find_hospital3f_seeds_for_code(
     uint32_t targetCodePacked,
     int maxResults,
     RngBackend backend,
-    int minAdvances = 0,
-    int maxAdvances = 10'000'000
+    int64_t minAdvances = 0,
+    int64_t maxAdvances = 10'000'000
 ) {
-    std::vector<HospitalMatch> out;
-    out.reserve((size_t)maxResults);
-
-    uint32_t seedWarm = startSeed;
-
-    for (int i = 0; i < minAdvances; ++i) {
-        rng_next31(seedWarm, backend);
-    }
-
-    for (int adv = minAdvances; adv <= maxAdvances; ++adv) {
-        uint32_t code = gen_hospital3f_code_from_seed(seedWarm, backend);
-        if (code == targetCodePacked) {
-            out.push_back({adv, seedWarm, code});
-            if ((int)out.size() >= maxResults) break;
-        }
-        rng_next31(seedWarm, backend);
-    }
-
-    return out;
+    const ResiduePredicate pred = compile_code_predicate(targetCodePacked, 1, 9);
+    if (pred.empty()) return {};
+
+    auto emit = [&](int64_t adv, uint32_t seedWarm, std::vector<HospitalMatch> &o) {
+        o.push_back({adv, seedWarm, targetCodePacked});
+    };
+    return find_indexed<HospitalMatch>(IndexPuzzle::Hospital3F, encode_draw_tuple(targetCodePacked, 1, 9),
+        startSeed, backend, minAdvances, maxAdvances, maxResults, emit,
+        [&](int64_t first, int64_t last, int quota) {
+            return scan_sharded<HospitalMatch>(startSeed, backend, first, last, quota,
+                [&](const ScanShard &shard, std::vector<HospitalMatch> &out) {
+                    scan_shard_predicate(shard, backend, pred, quota, out, emit);
+                });
+        });
 }
 
 static void print_crematorium(uint32_t code, bool forced7, int forcedPosLSB) {
@@ -1248,89 +5051,52 @@ static std::optional<uint32_t> parse_crematorium_code_input(const std::string& s
     return packed;
 }
 
-struct CrematoriumMeta {
-    uint32_t codePacked;
-    bool forced7;
-    int forcedPosLSB; 
-};
-
 static inline CrematoriumMeta gen_crematorium_meta_from_seed(uint32_t seedAfterWarmup, RngBackend backend) {
-    std::array<int,10> pool = {0,1,2,3,4,5,6,7,8,9};
-    int poolSize = 10;
-
-    uint32_t packed = 0;
-    bool saw7 = false;
-
-    for (int i = 0; i < 4; ++i) {
-        uint32_t r = rng_next31(seedAfterWarmup, backend);
-        int idx = (int)(r % (uint32_t)poolSize);
-        int digit = pool[idx];
-        if (digit == 7) saw7 = true;
-        packed = (packed << 4) | (uint32_t)digit;
-
-        for (int j = idx; j < poolSize - 1; ++j) pool[j] = pool[j + 1];
-        poolSize--;
-    }
-
-    bool forced7 = false;
-    int forcedPos = -1;
-
-    if (!saw7) {
-        uint32_t r = rng_next31(seedAfterWarmup, backend);
-        forcedPos = (int)(r % 4u);
-        forced7 = true;
-        uint32_t shift = (uint32_t)(forcedPos * 4);
-        packed = (packed & ~(0xFu << shift)) | (7u << shift);
-    }
+    const CrematoriumDecode &decode = CREMATORIUM_CODES[draw_tuple<10>(seedAfterWarmup, backend)];
+    if (decode.has7) return {decode.forced[0], false, -1};
 
-    return {packed, forced7, forcedPos};
+    int forcedPos = (int)(rng_next31(seedAfterWarmup, backend) % 4u);
+    return {decode.forced[forcedPos], true, forcedPos};
 }
 
-uint32_t gen_crematorium_code_guarantee7(uint32_t seed, int warmupAfterReset, RngBackend backend, bool verbose) {
-    rng_advance(seed, backend, warmupAfterReset);
-
-    std::vector<int> remainingDigits{0,1,2,3,4,5,6,7,8,9};
-
-    uint32_t packedCode = 0;
-    bool sawSeven = false;
+uint32_t gen_crematorium_code_guarantee7(uint32_t seed, int64_t warmupAfterReset, RngBackend backend, bool verbose) {
+    rng_advance(seed, backend, (uint64_t)std::max<int64_t>(warmupAfterReset, 0));
 
+    uint32_t r[4];
+    uint32_t tuple = 0;
     for (int draw = 0; draw < 4; ++draw) {
-        uint32_t r = rng_next31(seed, backend);
-        int poolSize = 10 - draw;
-        int pickIndex = (int)(r % (uint32_t)poolSize);
-
-        int digit = remainingDigits[pickIndex];
-        if (digit == 7) sawSeven = true;
-
-        packedCode = (packedCode << 4) | (uint32_t)digit;
+        r[draw] = rng_next31(seed, backend);
+        uint32_t poolSize = 10u - (uint32_t)draw;
+        tuple = tuple * poolSize + r[draw] % poolSize;
+    }
+    const CrematoriumDecode &decode = CREMATORIUM_CODES[tuple];
+    uint32_t drawnCode = SHAKESPEARE_CODES[tuple];
 
-        if (verbose) {
+    if (verbose) {
+        for (int draw = 0; draw < 4; ++draw) {
+            int poolSize = 10 - draw;
+            uint32_t digit = (drawnCode >> (12 - 4 * draw)) & 0xF;
             std::cout << "draw#" << (draw + 1)
-                      << " r=0x" << std::hex << std::uppercase << r << std::dec
+                      << " r=0x" << std::hex << std::uppercase << r[draw] << std::dec
                       << " poolSize=" << poolSize
-                      << " pickIndex=" << pickIndex
+                      << " pickIndex=" << (r[draw] % (uint32_t)poolSize)
                       << " digit=" << digit
                       << (digit == 7 ? " (saw 7)" : "")
                       << "\n";
         }
-
-        remainingDigits.erase(remainingDigits.begin() + pickIndex);
     }
 
-    if (!sawSeven) {
-        uint32_t r = rng_next31(seed, backend);
-        int posLSB = (int)(r % 4u);
-        uint32_t shift = (uint32_t)(posLSB * 4);
+    if (decode.has7) return drawnCode;
 
-        uint32_t before = packedCode;
-        packedCode = (packedCode & ~(0xFu << shift)) | (7u << shift);
+    uint32_t rForce = rng_next31(seed, backend);
+    int posLSB = (int)(rForce % 4u);
+    uint32_t packedCode = decode.forced[posLSB];
 
-        if (verbose) {
-            std::cout << "force7 r=0x" << std::hex << std::uppercase << r << std::dec
-                      << " posLSB=" << posLSB
-                      << " before=0x" << std::hex << std::uppercase << before
-                      << " after=0x" << packedCode << std::dec << "\n";
-        }
+    if (verbose) {
+        std::cout << "force7 r=0x" << std::hex << std::uppercase << rForce << std::dec
+                  << " posLSB=" << posLSB
+                  << " before=0x" << std::hex << std::uppercase << drawnCode
+                  << " after=0x" << packedCode << std::dec << "\n";
     }
 
     return packedCode;
@@ -1341,26 +5107,22 @@ static std::vector<CrematoriumMatch> find_crematorium_seeds_for_code(
     uint32_t targetCodePacked,
     int maxResults,
     RngBackend backend,
-    int minAdvances,
-    int maxAdvances
+    int64_t minAdvances,
+    int64_t maxAdvances
 ) {
-    std::vector<CrematoriumMatch> out;
-    out.reserve((size_t)maxResults);
-
-    uint32_t seedWarm = startSeed;
-    for (int i = 0; i < minAdvances; ++i) {
-        rng_next31(seedWarm, backend);
-    }
-
-    for (int adv = minAdvances; adv <= maxAdvances; ++adv) {
-        uint32_t tmp = seedWarm;
-        CrematoriumMeta meta = gen_crematorium_meta_from_seed(tmp, backend);
-        if (meta.codePacked == targetCodePacked) {
-            out.push_back({adv, seedWarm, meta.codePacked, meta.forced7, meta.forcedPosLSB});
-            if ((int)out.size() >= maxResults) break;
-        }
-        rng_next31(seedWarm, backend);
-    }
-
-    return out;
+    const ResiduePredicate pred = compile_crematorium_predicate(targetCodePacked);
+    if (pred.empty()) return {};
+
+    auto emit = [&](int64_t adv, uint32_t seedWarm, std::vector<CrematoriumMatch> &o) {
+        CrematoriumMeta meta = gen_crematorium_meta_from_seed(seedWarm, backend);
+        o.push_back({adv, seedWarm, meta.codePacked, meta.forced7, meta.forcedPosLSB});
+    };
+    return find_indexed<CrematoriumMatch>(IndexPuzzle::Crematorium, encode_draw_tuple(targetCodePacked, 0, 10),
+        startSeed, backend, minAdvances, maxAdvances, maxResults, emit,
+        [&](int64_t first, int64_t last, int quota) {
+            return scan_sharded<CrematoriumMatch>(startSeed, backend, first, last, quota,
+                [&](const ScanShard &shard, std::vector<CrematoriumMatch> &out) {
+                    scan_shard_predicate(shard, backend, pred, quota, out, emit);
+                });
+        });
 }